@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <time.h>
+
+typedef long long Elem_t;
+void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "%lld", val); }
+
+#define STACK_USE_ADAPTIVE_CAPACITY
+#include "stack.h"
+
+// A request handler makes a stack, fills it with 40..80 elements, empties it and destroys it.
+// Stacks made without a place of construction (orig_file_name == NULL) grow from 0 as usual,
+// stacks made by stack_ctor() get the learned capacity at the first push. The best of RUNS runs is printed.
+
+const long REQUESTS = 2000000;
+const int RUNS = 3;
+
+static double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static long long handle_request(Stack *stk, long request)
+{
+    stacksize_t depth = 40 + (request * 7919) % 41;
+    for (stacksize_t ind = 0; ind < depth; ind++) stack_push(stk, ind);
+
+    long long checksum = 0;
+    Elem_t x = 0;
+    while (stack_pop(stk, &x) == STACK_ERROR_NO_ERROR) checksum += x;
+
+    return checksum;
+}
+
+static long long bench_plain()
+{
+    double best = 0;
+    long long checksum = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        clock_t start = clock();
+        checksum = 0;
+        for (long request = 0; request < REQUESTS; request++)
+        {
+            Stack stk = {};
+            stack_ctor_(&stk, "stk", NULL, -1, NULL);
+            checksum += handle_request(&stk, request);
+            stack_dtor(&stk);
+        }
+        double seconds = seconds_since(start);
+        if (run == 0 || seconds < best) best = seconds;
+    }
+
+    printf("%-28s %6.3f s (checksum %lld)\n", "growing from 0", best, checksum);
+    return checksum;
+}
+
+static long long bench_adaptive()
+{
+    double best = 0;
+    long long checksum = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        clock_t start = clock();
+        checksum = 0;
+        for (long request = 0; request < REQUESTS; request++)
+        {
+            Stack stk = {};
+            stack_ctor(&stk);
+            checksum += handle_request(&stk, request);
+            stack_dtor(&stk);
+        }
+        double seconds = seconds_since(start);
+        if (run == 0 || seconds < best) best = seconds;
+    }
+
+    printf("%-28s %6.3f s (checksum %lld)\n", "adaptive initial capacity", best, checksum);
+    return checksum;
+}
+
+int main()
+{
+    printf("%ld requests, STACK_ADAPTIVE_PERCENTILE = %d\n", REQUESTS, STACK_ADAPTIVE_PERCENTILE);
+
+    int is_wrong = bench_plain() != bench_adaptive();
+
+    printf("Learned table:\n");
+    is_wrong |= stack_adaptive_export(stdout) != STACK_ERROR_NO_ERROR;
+
+    return is_wrong;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef long long Elem_t;
+void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "%lld", val); }
+
+#include "stack.h"
+#include "blocking_stack.h"
+
+// P producers push N values in total to a bounded BlockingStack, C consumers pop them
+// either one by one or in batches. Both the sum of the popped values and their count are checked.
+
+const long long N = 4000000;
+const stacksize_t CAPACITY = 1024;
+const stacksize_t BATCH = 64;
+
+struct BenchThread
+{
+    BlockingStack *stk;
+    long long first;
+    long long count;
+    stacksize_t batch;
+    long long sum;
+    long long popped;
+};
+
+static double now_seconds()
+{
+    timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void *producer(void *arg)
+{
+    BenchThread *thr = (BenchThread *) arg;
+    for (long long ind = thr->first; ind < thr->first + thr->count; ind++) blocking_stack_push(thr->stk, ind);
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    BenchThread *thr = (BenchThread *) arg;
+    Elem_t buf[BATCH] = {};
+    stacksize_t count = 0;
+
+    while (blocking_stack_pop_batch(thr->stk, buf, thr->batch, &count, -1) == STACK_ERROR_NO_ERROR)
+    {
+        for (stacksize_t ind = 0; ind < count; ind++) thr->sum += buf[ind];
+        thr->popped += count;
+    }
+    return NULL;
+}
+
+static int bench(int producers, int consumers, stacksize_t batch)
+{
+    BlockingStack stk = {};
+    blocking_stack_ctor(&stk, CAPACITY);
+
+    BenchThread threads[64] = {};
+    pthread_t ids[64] = {};
+    double start = now_seconds();
+
+    for (int ind = 0; ind < producers; ind++)
+    {
+        threads[ind] = {&stk, N / producers * ind, N / producers, 0, 0, 0};
+        if (ind == producers - 1) threads[ind].count = N - threads[ind].first;
+        pthread_create(&ids[ind], NULL, producer, &threads[ind]);
+    }
+    for (int ind = producers; ind < producers + consumers; ind++)
+    {
+        threads[ind] = {&stk, 0, 0, batch, 0, 0};
+        pthread_create(&ids[ind], NULL, consumer, &threads[ind]);
+    }
+
+    for (int ind = 0; ind < producers; ind++) pthread_join(ids[ind], NULL);
+    blocking_stack_close(&stk);
+
+    long long sum = 0, popped = 0;
+    for (int ind = producers; ind < producers + consumers; ind++)
+    {
+        pthread_join(ids[ind], NULL);
+        sum += threads[ind].sum;
+        popped += threads[ind].popped;
+    }
+    double seconds = now_seconds() - start;
+    blocking_stack_dtor(&stk);
+
+    printf("%2d producers x %2d consumers, batch %2ld: %7.3f s, %6.2f Mops/s\n",
+           producers, consumers, (long) batch, seconds, (double) N / seconds / 1e6);
+
+    return sum != N * (N - 1) / 2 || popped != N;
+}
+
+int main()
+{
+    printf("N = %lld values, capacity " STACKSIZE_T_SPECF "\n", N, CAPACITY);
+
+    const int configs[][2] = { {1, 1}, {4, 4}, {8, 2}, {2, 8}, {16, 16} };
+    int is_wrong = 0;
+
+    for (size_t ind = 0; ind < sizeof(configs) / sizeof(configs[0]); ind++)
+    {
+        is_wrong |= bench(configs[ind][0], configs[ind][1], 1);
+        is_wrong |= bench(configs[ind][0], configs[ind][1], BATCH);
+    }
+
+    return is_wrong;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <time.h>
+
+typedef long long Elem_t;
+void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "%lld", val); }
+
+#include "stack.h"
+#include "bit_stack.h"
+#include "compact_int_stack.h"
+
+// Two patterns: DFS visited flags (1-bit values) and an operand stack of small integers.
+// Every stack is filled with N values and then emptied; memory is measured at the peak.
+
+const stacksize_t N = 20000000;
+
+static double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static size_t stack_memory(const Stack *stk)
+{
+    return sizeof(*stk) + stack_data_block_size_( (size_t) stk->capacity*sizeof(Elem_t)*STACK_DATA_ARRAYS_NUM,
+                                                  sizeof(Elem_t) );
+}
+
+static size_t bit_stack_memory(const BitStack *stk)
+{
+    return sizeof(*stk) + stack_data_block_size_( (size_t) (stk->capacity / bit_stack_per_word_(stk))*sizeof(uint64_t),
+                                                  sizeof(uint64_t) );
+}
+
+static void print_result(const char *name, double seconds, size_t memory, long long checksum)
+{
+    printf("%-34s %7.3f s, %9.2f MB at peak, %5.2f bits per value (checksum %lld)\n",
+           name, seconds, (double) memory / (1 << 20), 8.0 * (double) memory / (double) N, checksum);
+}
+
+static long long bench_stack(Elem_t (*gen)(stacksize_t), const char *name)
+{
+    long long checksum = 0;
+    clock_t start = clock();
+
+    Stack stk = {};
+    stack_ctor(&stk);
+    for (stacksize_t ind = 0; ind < N; ind++) stack_push(&stk, gen(ind));
+    size_t memory = stack_memory(&stk);
+
+    Elem_t x = 0;
+    while (stack_pop(&stk, &x) == STACK_ERROR_NO_ERROR) checksum += x;
+    stack_dtor(&stk);
+
+    print_result(name, seconds_since(start), memory, checksum);
+    return checksum;
+}
+
+static Elem_t gen_flag(stacksize_t ind)
+{
+    return (ind * 7) % 3 == 0;
+}
+
+static Elem_t gen_small_int(stacksize_t ind)
+{
+    return (ind * 13) % 100;
+}
+
+static long long bench_bit_stack()
+{
+    long long checksum = 0;
+    clock_t start = clock();
+
+    BitStack stk = {};
+    bit_stack_ctor(&stk, 1);
+    for (stacksize_t ind = 0; ind < N; ind++) bit_stack_push(&stk, (unsigned) gen_flag(ind));
+    size_t memory = bit_stack_memory(&stk);
+
+    unsigned x = 0;
+    while (bit_stack_pop(&stk, &x) == STACK_ERROR_NO_ERROR) checksum += x;
+    bit_stack_dtor(&stk);
+
+    print_result("BitStack(1), push/pop", seconds_since(start), memory, checksum);
+    return checksum;
+}
+
+static long long bench_bit_stack_words()
+{
+    long long checksum = 0;
+    clock_t start = clock();
+
+    BitStack stk = {};
+    bit_stack_ctor(&stk, 1);
+    for (stacksize_t ind = 0; ind < N; ind += 64)
+    {
+        uint64_t packed = 0;
+        for (int bit = 0; bit < 64; bit++) packed |= (uint64_t) gen_flag(ind + bit) << bit;
+        bit_stack_push_word(&stk, packed, 64);
+    }
+    size_t memory = bit_stack_memory(&stk);
+
+    uint64_t packed = 0;
+    while (bit_stack_pop_word(&stk, 64, &packed) == STACK_ERROR_NO_ERROR) checksum += __builtin_popcountll(packed);
+    bit_stack_dtor(&stk);
+
+    print_result("BitStack(1), push/pop_word(64)", seconds_since(start), memory, checksum);
+    return checksum;
+}
+
+static long long bench_compact_int_stack()
+{
+    long long checksum = 0;
+    clock_t start = clock();
+
+    CompactIntStack stk = {};
+    compact_int_stack_ctor(&stk);
+    for (stacksize_t ind = 0; ind < N; ind++) compact_int_stack_push(&stk, gen_small_int(ind));
+    size_t memory = compact_int_stack_memory(&stk);
+
+    int64_t x = 0;
+    while (compact_int_stack_pop(&stk, &x) == STACK_ERROR_NO_ERROR) checksum += x;
+    compact_int_stack_dtor(&stk);
+
+    print_result("CompactIntStack, push/pop", seconds_since(start), memory, checksum);
+    return checksum;
+}
+
+int main()
+{
+    printf("N = " STACKSIZE_T_SPECF " values, Elem_t is long long\n", N);
+
+    printf("Flags:\n");
+    long long checksum_flags = bench_stack(gen_flag, "Stack, push/pop");
+    int is_wrong = checksum_flags != bench_bit_stack();
+    is_wrong |= checksum_flags != bench_bit_stack_words();
+
+    printf("Small integers [0, 100):\n");
+    long long checksum_ints = bench_stack(gen_small_int, "Stack, push/pop");
+    is_wrong |= checksum_ints != bench_compact_int_stack();
+
+    return is_wrong;
+}
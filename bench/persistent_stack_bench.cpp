@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <time.h>
+
+typedef long long Elem_t;
+void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "%lld", val); }
+
+#include "stack.h"
+#include "persistent_stack.h"
+
+// Backtracking pattern: at every branch point the stack is saved (a Stack is copied with one memcpy), a few elements are pushed
+// and popped, then the stack is rolled back to the saved state.
+
+const stacksize_t DEPTH      = 100000;
+const int         BRANCHES   = 2000;
+const int         BRANCH_LEN = 16;
+
+static double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+//! @brief Copies the stack the cheapest way: one block of src->capacity elements and one memcpy.
+static void stack_copy(Stack *dst, Stack *src)
+{
+    stack_ctor(dst);
+    dst->capacity = src->capacity;
+    stack_realloc_helper_(dst, &dst->data, &dst->p_origin);
+    memcpy(dst->data, src->data, (size_t) src->size*sizeof(Elem_t));
+    dst->size = src->size;
+}
+
+static long long bench_stack_copy()
+{
+    long long checksum = 0;
+
+    Stack stk = {};
+    stack_ctor(&stk);
+    for (stacksize_t ind = 0; ind < DEPTH; ind++) stack_push(&stk, ind);
+
+    for (int branch = 0; branch < BRANCHES; branch++)
+    {
+        Stack saved = {};
+        stack_copy(&saved, &stk);
+
+        for (int ind = 0; ind < BRANCH_LEN; ind++) stack_push(&stk, branch + ind);
+
+        Elem_t x = 0;
+        stack_pop(&stk, &x);
+        checksum += x;
+
+        stack_dtor(&stk);
+        stk = saved;
+    }
+
+    stack_dtor(&stk);
+    return checksum;
+}
+
+static long long bench_persistent_stack()
+{
+    long long checksum = 0;
+
+    PersistentStack stk = {};
+    PersistentStack saved = {};
+    persistent_stack_ctor(&stk);
+    persistent_stack_ctor(&saved);
+    for (stacksize_t ind = 0; ind < DEPTH; ind++) persistent_stack_push(&stk, ind);
+
+    for (int branch = 0; branch < BRANCHES; branch++)
+    {
+        persistent_stack_snapshot(&saved, &stk);
+
+        for (int ind = 0; ind < BRANCH_LEN; ind++) persistent_stack_push(&stk, branch + ind);
+
+        Elem_t x = 0;
+        persistent_stack_pop(&stk, &x);
+        checksum += x;
+
+        persistent_stack_rollback(&stk, &saved);
+    }
+
+    persistent_stack_dtor(&saved);
+    persistent_stack_dtor(&stk);
+    return checksum;
+}
+
+int main()
+{
+    printf("depth = " STACKSIZE_T_SPECF ", branches = %d, branch length = %d\n", DEPTH, BRANCHES, BRANCH_LEN);
+
+    clock_t start = clock();
+    long long checksum_copy = bench_stack_copy();
+    printf("Stack, copy per branch:           %.3f s (checksum %lld)\n", seconds_since(start), checksum_copy);
+
+    start = clock();
+    long long checksum_persistent = bench_persistent_stack();
+    printf("PersistentStack, O(1) snapshots:  %.3f s (checksum %lld)\n", seconds_since(start), checksum_persistent);
+
+    return checksum_copy != checksum_persistent;
+}
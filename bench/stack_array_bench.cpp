@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <time.h>
+#include <malloc.h>
+
+typedef long long Elem_t;
+void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "%lld", val); }
+
+#include "stack.h"
+#include "stack_array.h"
+
+// K connections, each with its own small stack of 0..32 elements. Pushes go round-robin over
+// the connections, then all stacks are summed, then every second connection is closed.
+// Memory is measured with malloc_usable_size() plus one word of malloc's chunk header per block,
+// after the fill; StackArray is compacted by then.
+
+const stacksize_t K = 200000;
+const stacksize_t MAX_DEPTH = 32;
+
+static double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static stacksize_t depth(stacksize_t conn)
+{
+    return (stacksize_t) (((unsigned long long) conn * 2654435761ull >> 7) % (MAX_DEPTH + 1));
+}
+
+static size_t heap_block(void *p)
+{
+    return (p) ? malloc_usable_size(p) + sizeof(size_t) : 0;
+}
+
+static size_t elements_memory()
+{
+    size_t elems = 0;
+    for (stacksize_t conn = 0; conn < K; conn++) elems += (size_t) depth(conn);
+
+    return elems*sizeof(Elem_t);
+}
+
+static void print_result(const char *name, double fill, double iterate, double close, size_t memory, long long checksum)
+{
+    printf("%-10s fill %6.3f s, iterate %6.3f s, close half %6.3f s, %6.2f MB, "
+           "%5.1f bytes per stack above elements (checksum %lld)\n",
+           name, fill, iterate, close, (double) memory / (1 << 20),
+           (double) (memory - elements_memory()) / (double) K, checksum);
+}
+
+static long long bench_stacks()
+{
+    clock_t start = clock();
+
+    Stack *stacks = (Stack *) calloc((size_t) K, sizeof(Stack));
+    for (stacksize_t conn = 0; conn < K; conn++) stack_ctor(&stacks[conn]);
+    for (stacksize_t round = 0; round < MAX_DEPTH; round++)
+    {
+        for (stacksize_t conn = 0; conn < K; conn++)
+        {
+            if (round < depth(conn)) stack_push(&stacks[conn], conn + round);
+        }
+    }
+    double fill = seconds_since(start);
+
+    size_t memory = heap_block(stacks);
+    for (stacksize_t conn = 0; conn < K; conn++) memory += heap_block(stacks[conn].p_origin);
+
+    start = clock();
+    long long checksum = 0;
+    for (stacksize_t conn = 0; conn < K; conn++)
+    {
+        for (stacksize_t ind = 0; ind < stacks[conn].size; ind++) checksum += stacks[conn].data[ind];
+    }
+    double iterate = seconds_since(start);
+
+    start = clock();
+    for (stacksize_t conn = 0; conn < K; conn += 2) stack_dtor(&stacks[conn]);
+    double close = seconds_since(start);
+
+    print_result("Stack", fill, iterate, close, memory, checksum);
+
+    for (stacksize_t conn = 1; conn < K; conn += 2) stack_dtor(&stacks[conn]);
+    free(stacks);
+    return checksum;
+}
+
+static long long bench_stack_array()
+{
+    clock_t start = clock();
+
+    StackArray arr = {};
+    stack_array_ctor(&arr, 0);
+    stacksize_t *ids = (stacksize_t *) calloc((size_t) K, sizeof(stacksize_t));
+    stack_array_create(&arr, K, 0, ids);
+    for (stacksize_t round = 0; round < MAX_DEPTH; round++)
+    {
+        for (stacksize_t conn = 0; conn < K; conn++)
+        {
+            if (round < depth(conn)) stack_array_push(&arr, ids[conn], conn + round);
+        }
+    }
+    stack_array_compact(&arr, 0);
+    double fill = seconds_since(start);
+
+    size_t memory = heap_block(arr.p_origin) + heap_block(arr.headers) + sizeof(arr);
+
+    start = clock();
+    long long checksum = 0;
+    for (stacksize_t conn = 0; conn < K; conn++)
+    {
+        const Elem_t *data = NULL;
+        stacksize_t size = 0;
+        stack_array_view(&arr, ids[conn], &data, &size);
+        for (stacksize_t ind = 0; ind < size; ind++) checksum += data[ind];
+    }
+    double iterate = seconds_since(start);
+
+    start = clock();
+    stacksize_t closed = 0;
+    for (stacksize_t conn = 0; conn < K; conn += 2) ids[closed++] = ids[conn];
+    stack_array_destroy(&arr, closed, ids);
+    stack_array_compact(&arr, 0);
+    double close = seconds_since(start);
+
+    print_result("StackArray", fill, iterate, close, memory, checksum);
+
+    stack_array_dtor(&arr);
+    free(ids);
+    return checksum;
+}
+
+int main()
+{
+    printf("K = " STACKSIZE_T_SPECF " stacks of 0.." STACKSIZE_T_SPECF " elements, Elem_t is long long\n", K, MAX_DEPTH);
+
+    return bench_stacks() != bench_stack_array();
+}
@@ -0,0 +1,595 @@
+#ifndef BIT_STACK_H
+#define BIT_STACK_H
+
+#include <stdint.h>
+
+#include "stack.h"
+
+/*
+    Stack of small unsigned values of 1 to 8 bits each (flags, colors, small opcodes),
+    packed into 64-bit words: 64 / bits values per word, none of them crosses a word border.
+    For example, 1-bit flags take 64 times less memory than in Stack of long long.
+
+    bit_stack_push_word() and bit_stack_pop_word() move up to 64 / bits values at once,
+    packed in one word the same way as in the stack: value number i takes bits
+    [i*bits, (i + 1)*bits). Value pushed first is the lowest.
+
+    USAGE:
+    BitStack stk = {};
+    bit_stack_ctor(&stk, 1);
+    bit_stack_push(&stk, 1);
+    bit_stack_push_word(&stk, 0xFF, 8);     // eight ones at once
+*/
+
+const int BIT_STACK_MAX_BITS = 8;
+const stacksize_t BIT_STACK_MIN_WORDS = 4;
+
+#ifdef STACK_USE_POISON
+const uint64_t BIT_STACK_POISON_WORD = 0x0101010101010101ULL * POISON_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+const stacksize_t BIT_STACK_DUMP_MAX_WORDS = 16;
+#endif
+
+struct BitStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    uint64_t *data = NULL;
+    stacksize_t size = -1;      //< Количество значений в стеке.
+    stacksize_t capacity = -1;  //< Сколько значений помещается в выделенные слова.
+    int bits = -1;              //< Размер одного значения в битах.
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+    void *p_origin = NULL;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t* p_data_canary_left = NULL;
+    canary_t* p_data_canary_right = NULL;
+
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks bit stack's condition.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int bit_stack_verify(BitStack *stk);
+
+//! @brief Bit stack constructor. ONLY FOR INTERNAL USE! USE MACRO bit_stack_ctor()!
+//! @details It doesn't allocate memory, first push() will do it.
+//! @param [in] stk Pointer to stack to construct.
+//! @param [in] bits Size of one value in bits, from 1 to BIT_STACK_MAX_BITS.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if bits is out of range.
+StackErrorCode bit_stack_ctor_( BitStack *stk, int bits
+#ifdef STACK_DO_DUMP
+                                ,
+                                const char *stack_name,
+                                const char *orig_file_name,
+                                const int orig_line,
+                                const char *orig_func_name
+#endif
+                              );
+
+//! @brief Bit stack deconstructor.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode bit_stack_dtor(BitStack *stk);
+
+//! @brief Pushes one value to the stack.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push, STACK_ERROR_BAD_ARG is returned if it doesn't fit in stk->bits.
+//! @return StackErrorCode enum value.
+static StackErrorCode bit_stack_push(BitStack *stk, unsigned value);
+
+//! @brief Pushes count values at once.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] packed Values packed like in the stack (the last one to push is the highest), higher bits are ignored.
+//! @param [in] count Number of values, from 1 to 64 / stk->bits.
+//! @return StackErrorCode enum value.
+static StackErrorCode bit_stack_push_word(BitStack *stk, uint64_t packed, int count);
+
+//! @brief Pops one value from the stack.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value.
+static StackErrorCode bit_stack_pop(BitStack *stk, unsigned *ret_value);
+
+//! @brief Pops count values at once.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] count Number of values, from 1 to 64 / stk->bits.
+//! @param [in] ret_packed Pointer to put popped values to, packed like in the stack (the top one is the highest).
+//! @return StackErrorCode enum value, STACK_ERROR_NOTHING_TO_POP if there are less than count values.
+static StackErrorCode bit_stack_pop_word(BitStack *stk, int count, uint64_t *ret_packed);
+
+//! @brief Reallocs the words so that they can hold need values, or shrinks them if they are mostly empty.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] need Number of values the stack must be able to hold.
+//! @return StackErrorCode enum value.
+static StackErrorCode bit_stack_realloc(BitStack *stk, stacksize_t need);
+
+#ifndef STACK_DO_DUMP
+
+#define BIT_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define BIT_STACK_DUMP(stk, verify_res) bit_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void bit_stack_dump_(BitStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//------------------------------------BIT_STACK.CPP-------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define BIT_STACK_CHECK(stk)    {                   \
+    int verify_res = bit_stack_verify(stk);         \
+    if ( verify_res != 0 ) {                        \
+        BIT_STACK_DUMP(stk, verify_res);            \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+//! @brief Returns the number of values in one word.
+inline int bit_stack_per_word_(const BitStack *stk)
+{
+    return 64 / stk->bits;
+}
+
+//! @brief Returns the number of words holding values [0, size).
+inline stacksize_t bit_stack_words_(const BitStack *stk, stacksize_t size)
+{
+    return (size + bit_stack_per_word_(stk) - 1) / bit_stack_per_word_(stk);
+}
+
+//! @brief Returns the mask of n lowest bits, n can be from 0 to 64.
+inline uint64_t bit_stack_mask_(int n)
+{
+    return (n >= 64) ? ~(uint64_t) 0 : ( ((uint64_t) 1 << n) - 1 );
+}
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t bit_stack_compute_hash_data_(BitStack *stk)
+{
+    assert(stk);
+
+    return stack_compute_hash( (char *) stk->data,
+                               (unsigned int) ((size_t) bit_stack_words_(stk, stk->size)*sizeof(uint64_t)) );
+}
+
+inline stackhash_t bit_stack_compute_hash_struct_(BitStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+inline void bit_stack_update_hash_(BitStack *stk)
+{
+    assert(stk);
+
+    stk->hash_data = (stk->data) ? bit_stack_compute_hash_data_(stk) : HASH_DEFAULT_VALUE;
+    stk->hash_struct = bit_stack_compute_hash_struct_(stk);
+}
+#endif
+
+int bit_stack_verify(BitStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( !(stk->data) && (stk->size != 0 || stk->capacity != 0) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( stk->size < 0 || stk->size > stk->capacity )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+    if ( stk->capacity < 0 || stk->bits < 1 || stk->bits > BIT_STACK_MAX_BITS )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+    else if ( stk->capacity % bit_stack_per_word_(stk) != 0 )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( stk->data && ( *(stk->p_data_canary_left) != CANARY_LEFT_DEFAULT_VALUE
+                     || *(stk->p_data_canary_right) != CANARY_RIGHT_DEFAULT_VALUE ) )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != bit_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->data && !(error & (STACK_VERIFY_SIZE_INVALID | STACK_VERIFY_CAPACITY_INVALID))
+      && stk->hash_data != bit_stack_compute_hash_data_(stk) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define bit_stack_ctor(stk, bits) bit_stack_ctor_(stk, bits, #stk, __FILE__, __LINE__, __func__)
+#else
+#define bit_stack_ctor(stk, bits) bit_stack_ctor_(stk, bits)
+#endif
+
+StackErrorCode bit_stack_ctor_( BitStack *stk, int bits
+#ifdef STACK_DO_DUMP
+                                ,
+                                const char *stack_name,
+                                const char *orig_file_name,
+                                const int orig_line,
+                                const char *orig_func_name
+#endif
+                              )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (bits < 1 || bits > BIT_STACK_MAX_BITS) return STACK_ERROR_BAD_ARG;
+
+    bit_stack_dtor(stk);
+
+    stk->data = NULL;
+    stk->p_origin = NULL;
+    stk->capacity = 0;
+    stk->size = 0;
+    stk->bits = bits;
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    bit_stack_update_hash_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode bit_stack_dtor(BitStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    stk->capacity = -1;
+    stk->size = -1;
+    stk->bits = -1;
+    if (stk->p_origin) free(stk->p_origin);
+    stk->p_origin = NULL;
+    stk->data = NULL;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+
+    stk->p_data_canary_left = NULL;
+    stk->p_data_canary_right = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stk->hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode bit_stack_push_word(BitStack *stk, uint64_t packed, int count)
+{
+    BIT_STACK_CHECK(stk)
+
+    int per_word = bit_stack_per_word_(stk);
+    if ( count < 1 || count > per_word ) return STACK_ERROR_BAD_ARG;
+
+    if ( stk->size + count > stk->capacity )
+    {
+        StackErrorCode mem_realloc_res = bit_stack_realloc(stk, stk->size + count);
+        if ( mem_realloc_res )
+        {
+            return mem_realloc_res;
+        }
+    }
+
+    stacksize_t word = stk->size / per_word;
+    int shift = (int) (stk->size % per_word) * stk->bits;
+    int first_count = (count < per_word - shift / stk->bits) ? count : per_word - shift / stk->bits;
+
+    uint64_t first_mask = bit_stack_mask_(first_count * stk->bits) << shift;
+    stk->data[word] = (stk->data[word] & ~first_mask) | ((packed << shift) & first_mask);
+
+    if (count > first_count)
+    {
+        uint64_t rest_mask = bit_stack_mask_( (count - first_count) * stk->bits );
+        stk->data[word + 1] = (stk->data[word + 1] & ~rest_mask)
+                            | ((packed >> (first_count * stk->bits)) & rest_mask);
+    }
+
+    stk->size += count;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    bit_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode bit_stack_push(BitStack *stk, unsigned value)
+{
+    if ( stk && stk->bits >= 1 && (value >> stk->bits) != 0 ) return STACK_ERROR_BAD_ARG;
+
+    return bit_stack_push_word(stk, value, 1);
+}
+
+StackErrorCode bit_stack_pop_word(BitStack *stk, int count, uint64_t *ret_packed)
+{
+    BIT_STACK_CHECK(stk)
+    if ( !ret_packed ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    int per_word = bit_stack_per_word_(stk);
+    if ( count < 1 || count > per_word ) return STACK_ERROR_BAD_ARG;
+
+    if (stk->size < count)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        BIT_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    stacksize_t new_size = stk->size - count;
+    stacksize_t word = new_size / per_word;
+    int shift = (int) (new_size % per_word) * stk->bits;
+    int first_count = (count < per_word - shift / stk->bits) ? count : per_word - shift / stk->bits;
+
+    uint64_t first_mask = bit_stack_mask_(first_count * stk->bits) << shift;
+    uint64_t packed = (stk->data[word] & first_mask) >> shift;
+#ifdef STACK_USE_POISON
+    stk->data[word] = (stk->data[word] & ~first_mask) | (BIT_STACK_POISON_WORD & first_mask);
+#endif
+
+    if (count > first_count)
+    {
+        uint64_t rest_mask = bit_stack_mask_( (count - first_count) * stk->bits );
+        packed |= (stk->data[word + 1] & rest_mask) << (first_count * stk->bits);
+#ifdef STACK_USE_POISON
+        stk->data[word + 1] = (stk->data[word + 1] & ~rest_mask) | (BIT_STACK_POISON_WORD & rest_mask);
+#endif
+    }
+
+    *ret_packed = packed;
+    stk->size = new_size;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    bit_stack_update_hash_(stk);
+#endif
+
+    // shrinking is checked only when a word gets free, not on every pop
+    if ( bit_stack_words_(stk, new_size) != bit_stack_words_(stk, new_size + count) )
+    {
+        return bit_stack_realloc(stk, stk->size);
+    }
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode bit_stack_pop(BitStack *stk, unsigned *ret_value)
+{
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    uint64_t packed = 0;
+    StackErrorCode pop_res = bit_stack_pop_word(stk, 1, &packed);
+    if ( pop_res )
+    {
+        return pop_res;
+    }
+
+    *ret_value = (unsigned) packed;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+//! @brief Allocates new_words words, copies the values to them, frees old ones.
+inline StackErrorCode bit_stack_realloc_to_(BitStack *stk, stacksize_t new_words)
+{
+    assert(stk);
+    assert(new_words >= bit_stack_words_(stk, stk->size));
+
+    size_t data_bytes = (size_t) new_words*sizeof(uint64_t);
+
+    void *p_new_origin = calloc( stack_data_block_size_(data_bytes, sizeof(uint64_t)), 1 );
+    if (!p_new_origin) return STACK_ERROR_MEM_BAD_REALLOC;
+
+    uint64_t *new_data = (uint64_t *) stack_place_data_( p_new_origin, data_bytes, sizeof(uint64_t)
+#ifdef STACK_USE_PROTECTION_CANARY
+                                                         , &stk->p_data_canary_left, &stk->p_data_canary_right
+#endif
+                                                       );
+
+    stacksize_t used_words = bit_stack_words_(stk, stk->size);
+#ifdef STACK_USE_POISON
+    for (stacksize_t word = used_words; word < new_words; word++)
+    {
+        new_data[word] = BIT_STACK_POISON_WORD;
+    }
+#endif
+    if (used_words > 0)
+    {
+        memcpy(new_data, stk->data, (size_t) used_words*sizeof(uint64_t));
+    }
+
+    if (stk->p_origin) free(stk->p_origin);
+
+    stk->data = new_data;
+    stk->p_origin = p_new_origin;
+    stk->capacity = new_words * bit_stack_per_word_(stk);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    bit_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode bit_stack_realloc(BitStack *stk, stacksize_t need)
+{
+    BIT_STACK_CHECK(stk)
+
+    const int MEM_MULTIPLIER = 2;
+
+    stacksize_t words = stk->capacity / bit_stack_per_word_(stk);
+    stacksize_t need_words = bit_stack_words_(stk, need);
+    if ( need_words > words )
+    {
+        stacksize_t new_words = (words == 0) ? BIT_STACK_MIN_WORDS : words;
+        while (new_words < need_words)
+        {
+            new_words *= MEM_MULTIPLIER;
+        }
+        return bit_stack_realloc_to_(stk, new_words);
+    }
+    else if ( words > BIT_STACK_MIN_WORDS && need_words * ( MEM_MULTIPLIER * MEM_MULTIPLIER ) <= words )
+    {
+        return bit_stack_realloc_to_(stk, words / MEM_MULTIPLIER);
+    }
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+//! @brief Prints at most BIT_STACK_DUMP_MAX_WORDS words around the top, every value as a hex digit pair.
+inline void bit_stack_dump_data_( BitStack *stk )
+{
+    fprintf(stderr, "\t{\n");
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_left,
+                                                                        *(stk->p_data_canary_left));
+#endif
+
+    int per_word = bit_stack_per_word_(stk);
+    stacksize_t words = stk->capacity / per_word;
+    stacksize_t top_word = (0 <= stk->size && stk->size <= stk->capacity) ? stk->size / per_word : 0;
+    stacksize_t first = top_word - BIT_STACK_DUMP_MAX_WORDS / 2;
+    if (first < 0) first = 0;
+    stacksize_t last = first + BIT_STACK_DUMP_MAX_WORDS;
+    if (last > words) last = words;
+
+    if (first > 0) fprintf(stderr, "\t\t... words [0.." STACKSIZE_T_SPECF ") skipped\n", first);
+
+    for (stacksize_t word = first; word < last; word++)
+    {
+        fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "][%p]\t = <%016llX> values <",
+                word, (void *)(stk->data + word), (unsigned long long) stk->data[word]);
+        for (int slot = 0; slot < per_word; slot++)
+        {
+            unsigned value = (unsigned) ( (stk->data[word] >> (slot * stk->bits)) & bit_stack_mask_(stk->bits) );
+            fprintf(stderr, " %s%X", (word * per_word + slot == stk->size) ? "|" : "", value);
+        }
+        fprintf(stderr, " >");
+
+        if (word == top_word) fprintf(stderr, " <-- top at |");
+        fprintf(stderr, "\n");
+    }
+
+    if (last < words)
+    {
+        fprintf(stderr, "\t\t... words [" STACKSIZE_T_SPECF ".." STACKSIZE_T_SPECF ") skipped\n", last, words);
+    }
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_right,
+                                                                         *(stk->p_data_canary_right));
+#endif
+
+    fprintf(stderr, "\t}\n");
+}
+
+void bit_stack_dump_(BitStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "BitStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "BitStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcapacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\tbits = <%d>\n"
+                    "\tdata[%p]\n", stk->size, stk->capacity, stk->bits, (void *) stk->data);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+                    "\thash_data = <" STACKHASH_T_SPECF ">\n", stk->hash_struct, stk->hash_data);
+#endif
+    if ( !(stk->data) || stk->bits < 1 || stk->bits > BIT_STACK_MAX_BITS )
+    {
+        fprintf(stderr, "Data pointer is NULL or bits is invalid. Data cannot be accessed.\n");
+        return;
+    }
+
+    bit_stack_dump_data_(stk);
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // BIT_STACK_H
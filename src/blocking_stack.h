@@ -0,0 +1,598 @@
+#ifndef BLOCKING_STACK_H
+#define BLOCKING_STACK_H
+
+#include <pthread.h>
+#include <time.h>
+
+#include "stack.h"
+
+/*
+    Thread-safe stack of bounded capacity for producer/consumer pipelines. Push to a full
+    stack waits until there is room (backpressure), pop from an empty one waits until there
+    is an element. Linux only, link with -pthread.
+
+    Waiting is done on condition variables, and they are signalled only if somebody waits.
+    blocking_stack_pop_batch() takes up to max_count elements under one lock hold and wakes
+    all the waiting producers at once, which saves lock and wake-up traffic when consumers
+    are slower than producers.
+
+    blocking_stack_close() wakes everybody: pushes fail with STACK_ERROR_CLOSED from then on,
+    pops take what is left and then fail with STACK_ERROR_CLOSED too.
+
+    Timeouts are given in milliseconds: negative ones mean waiting forever, 0 means not waiting.
+
+    USAGE:
+    BlockingStack stk = {};
+    blocking_stack_ctor(&stk, 1024);
+    blocking_stack_push(&stk, value);                       // in producers
+    blocking_stack_pop_batch(&stk, buf, 64, &count, -1);    // in consumers
+    blocking_stack_close(&stk);                             // when producers are done
+*/
+
+//! @brief Synchronization state. It is allocated separately, so that waiting threads
+//! don't change BlockingStack and don't break its hash.
+struct BlockingStackSync_
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    long pushers_waiting;
+    long poppers_waiting;
+};
+
+struct BlockingStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    Elem_t *data = NULL;
+    stacksize_t size = -1;
+    stacksize_t capacity = -1;
+    int is_closed = 0;
+    BlockingStackSync_ *sync = NULL;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+    void *p_origin = NULL;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t* p_data_canary_left = NULL;
+    canary_t* p_data_canary_right = NULL;
+
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks blocking stack's condition. Call it only while holding stk->sync->lock
+//! or when no other thread uses the stack.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int blocking_stack_verify(BlockingStack *stk);
+
+//! @brief Blocking stack constructor. ONLY FOR INTERNAL USE! USE MACRO blocking_stack_ctor()!
+//! @details Allocates the whole buffer at once, it never grows.
+//! @param [in] stk Pointer to stack to construct.
+//! @param [in] capacity Maximum number of elements, must be positive.
+//! @return StackErrorCode enum value.
+StackErrorCode blocking_stack_ctor_( BlockingStack *stk, stacksize_t capacity
+#ifdef STACK_DO_DUMP
+                                     ,
+                                     const char *stack_name,
+                                     const char *orig_file_name,
+                                     const int orig_line,
+                                     const char *orig_func_name
+#endif
+                                   );
+
+//! @brief Blocking stack deconstructor. No thread may use or wait on the stack at that moment.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode blocking_stack_dtor(BlockingStack *stk);
+
+//! @brief Pushes element, waiting at most timeout_ms milliseconds for room.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push.
+//! @param [in] timeout_ms Timeout, negative means waiting forever, 0 means not waiting.
+//! @return StackErrorCode enum value, STACK_ERROR_OVERFLOW (not waiting), STACK_ERROR_TIMEOUT
+//! or STACK_ERROR_CLOSED if nothing was pushed.
+static StackErrorCode blocking_stack_push_timed(BlockingStack *stk, Elem_t value, long timeout_ms);
+
+//! @brief Pushes element, waiting for room as long as needed.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push.
+//! @return StackErrorCode enum value, STACK_ERROR_CLOSED if the stack is closed.
+static StackErrorCode blocking_stack_push(BlockingStack *stk, Elem_t value);
+
+//! @brief Pops up to max_count elements under one lock hold, waiting at most timeout_ms
+//! milliseconds for the first one. Elements are put to ret_values from the top down.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_values Array of at least max_count elements to put popped values to.
+//! @param [in] max_count Maximum number of elements to pop, must be positive.
+//! @param [in] ret_count Pointer to put the number of popped elements to.
+//! @param [in] timeout_ms Timeout, negative means waiting forever, 0 means not waiting.
+//! @return StackErrorCode enum value, STACK_ERROR_NOTHING_TO_POP (not waiting), STACK_ERROR_TIMEOUT
+//! or STACK_ERROR_CLOSED if nothing was popped.
+static StackErrorCode blocking_stack_pop_batch( BlockingStack *stk, Elem_t *ret_values, stacksize_t max_count,
+                                                stacksize_t *ret_count, long timeout_ms );
+
+//! @brief Pops element, waiting at most timeout_ms milliseconds for it.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @param [in] timeout_ms Timeout, negative means waiting forever, 0 means not waiting.
+//! @return StackErrorCode enum value, STACK_ERROR_NOTHING_TO_POP (not waiting), STACK_ERROR_TIMEOUT
+//! or STACK_ERROR_CLOSED if nothing was popped.
+static StackErrorCode blocking_stack_pop_timed(BlockingStack *stk, Elem_t *ret_value, long timeout_ms);
+
+//! @brief Pops element, waiting for it as long as needed.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value, STACK_ERROR_CLOSED if the stack is closed and empty.
+static StackErrorCode blocking_stack_pop(BlockingStack *stk, Elem_t *ret_value);
+
+//! @brief Closes the stack and wakes all the waiting threads.
+//! @param [in] stk Pointer to the stack.
+//! @return StackErrorCode enum value.
+static StackErrorCode blocking_stack_close(BlockingStack *stk);
+
+#ifndef STACK_DO_DUMP
+
+#define BLOCKING_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define BLOCKING_STACK_DUMP(stk, verify_res) blocking_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void blocking_stack_dump_(BlockingStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//---------------------------------BLOCKING_STACK.CPP-----------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+//! @brief Same as STACK_CHECK(), but it is called under the lock and releases it before dumping.
+#define BLOCKING_STACK_CHECK_LOCKED(stk)    {       \
+    int verify_res = blocking_stack_verify(stk);    \
+    if ( verify_res != 0 ) {                        \
+        pthread_mutex_unlock(&(stk)->sync->lock);   \
+        BLOCKING_STACK_DUMP(stk, verify_res);       \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t blocking_stack_compute_hash_data_(BlockingStack *stk)
+{
+    assert(stk);
+
+    return stack_compute_hash( (char *) stk->data, (unsigned int) ((size_t) stk->size*sizeof(Elem_t)) );
+}
+
+inline stackhash_t blocking_stack_compute_hash_struct_(BlockingStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+inline void blocking_stack_update_hash_(BlockingStack *stk)
+{
+    assert(stk);
+
+    stk->hash_data = (stk->data) ? blocking_stack_compute_hash_data_(stk) : HASH_DEFAULT_VALUE;
+    stk->hash_struct = blocking_stack_compute_hash_struct_(stk);
+}
+#endif
+
+int blocking_stack_verify(BlockingStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( !(stk->data) || !(stk->sync) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( stk->size < 0 || stk->size > stk->capacity )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+    if ( stk->capacity <= 0 )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( stk->data && ( *(stk->p_data_canary_left) != CANARY_LEFT_DEFAULT_VALUE
+                     || *(stk->p_data_canary_right) != CANARY_RIGHT_DEFAULT_VALUE ) )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != blocking_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->data && !(error & STACK_VERIFY_SIZE_INVALID) && stk->hash_data != blocking_stack_compute_hash_data_(stk) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//! @brief Turns timeout in milliseconds to the absolute CLOCK_MONOTONIC time.
+inline timespec blocking_stack_deadline_(long timeout_ms)
+{
+    timespec deadline = {};
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    return deadline;
+}
+
+//! @brief Waits on cond under the held lock, counting the waiter in *waiting.
+//! @return 0 if woken up, non-zero if the deadline has passed.
+inline int blocking_stack_wait_(BlockingStack *stk, pthread_cond_t *cond, long *waiting,
+                                long timeout_ms, const timespec *deadline)
+{
+    assert(stk);
+
+    (*waiting)++;
+    int wait_res = (timeout_ms < 0) ? pthread_cond_wait(cond, &stk->sync->lock)
+                                    : pthread_cond_timedwait(cond, &stk->sync->lock, deadline);
+    (*waiting)--;
+
+    return wait_res;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define blocking_stack_ctor(stk, capacity) blocking_stack_ctor_(stk, capacity, #stk, __FILE__, __LINE__, __func__)
+#else
+#define blocking_stack_ctor(stk, capacity) blocking_stack_ctor_(stk, capacity)
+#endif
+
+StackErrorCode blocking_stack_ctor_( BlockingStack *stk, stacksize_t capacity
+#ifdef STACK_DO_DUMP
+                                     ,
+                                     const char *stack_name,
+                                     const char *orig_file_name,
+                                     const int orig_line,
+                                     const char *orig_func_name
+#endif
+                                   )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (capacity <= 0) return STACK_ERROR_BAD_ARG;
+
+    blocking_stack_dtor(stk);
+
+    size_t data_bytes = (size_t) capacity*sizeof(Elem_t);
+    void *p_origin = calloc( stack_data_block_size_(data_bytes, sizeof(Elem_t)), 1 );
+    BlockingStackSync_ *sync = (BlockingStackSync_ *) calloc(1, sizeof(BlockingStackSync_));
+    if (!p_origin || !sync)
+    {
+        free(p_origin);
+        free(sync);
+        return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+
+    pthread_condattr_t cond_attr = {};
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&sync->lock, NULL);
+    pthread_cond_init(&sync->not_empty, &cond_attr);
+    pthread_cond_init(&sync->not_full, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    stk->data = (Elem_t *) stack_place_data_( p_origin, data_bytes, sizeof(Elem_t)
+#ifdef STACK_USE_PROTECTION_CANARY
+                                              , &stk->p_data_canary_left, &stk->p_data_canary_right
+#endif
+                                            );
+    stk->p_origin = p_origin;
+    stk->sync = sync;
+    stk->capacity = capacity;
+    stk->size = 0;
+    stk->is_closed = 0;
+#ifdef STACK_USE_POISON
+    for (stacksize_t ind = 0; ind < capacity; ind++)
+    {
+        fill_elem_with_poison_(stk->data + ind);
+    }
+#endif
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    blocking_stack_update_hash_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode blocking_stack_dtor(BlockingStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    if (stk->sync)
+    {
+        pthread_mutex_destroy(&stk->sync->lock);
+        pthread_cond_destroy(&stk->sync->not_empty);
+        pthread_cond_destroy(&stk->sync->not_full);
+        free(stk->sync);
+    }
+    stk->sync = NULL;
+
+    stk->capacity = -1;
+    stk->size = -1;
+    stk->is_closed = 0;
+    if (stk->p_origin) free(stk->p_origin);
+    stk->p_origin = NULL;
+    stk->data = NULL;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+
+    stk->p_data_canary_left = NULL;
+    stk->p_data_canary_right = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stk->hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode blocking_stack_push_timed(BlockingStack *stk, Elem_t value, long timeout_ms)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (!stk->sync) return STACK_ERROR_VERIFY;
+
+    timespec deadline = (timeout_ms > 0) ? blocking_stack_deadline_(timeout_ms) : timespec{};
+
+    pthread_mutex_lock(&stk->sync->lock);
+    BLOCKING_STACK_CHECK_LOCKED(stk)
+
+    while (stk->size == stk->capacity && !stk->is_closed)
+    {
+        if (timeout_ms == 0)
+        {
+            pthread_mutex_unlock(&stk->sync->lock);
+            return STACK_ERROR_OVERFLOW;
+        }
+        if ( blocking_stack_wait_(stk, &stk->sync->not_full, &stk->sync->pushers_waiting, timeout_ms, &deadline)
+          && stk->size == stk->capacity && !stk->is_closed )
+        {
+            pthread_mutex_unlock(&stk->sync->lock);
+            return STACK_ERROR_TIMEOUT;
+        }
+    }
+    if (stk->is_closed)
+    {
+        pthread_mutex_unlock(&stk->sync->lock);
+        return STACK_ERROR_CLOSED;
+    }
+
+    stk->data[(stk->size)++] = value;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    blocking_stack_update_hash_(stk);
+#endif
+
+    int is_signal_needed = stk->sync->poppers_waiting > 0;
+    pthread_mutex_unlock(&stk->sync->lock);
+
+    if (is_signal_needed) pthread_cond_signal(&stk->sync->not_empty);
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode blocking_stack_push(BlockingStack *stk, Elem_t value)
+{
+    return blocking_stack_push_timed(stk, value, -1);
+}
+
+StackErrorCode blocking_stack_pop_batch( BlockingStack *stk, Elem_t *ret_values, stacksize_t max_count,
+                                         stacksize_t *ret_count, long timeout_ms )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (!stk->sync) return STACK_ERROR_VERIFY;
+    if ( !ret_values || !ret_count ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if ( max_count <= 0 ) return STACK_ERROR_BAD_ARG;
+
+    *ret_count = 0;
+    timespec deadline = (timeout_ms > 0) ? blocking_stack_deadline_(timeout_ms) : timespec{};
+
+    pthread_mutex_lock(&stk->sync->lock);
+    BLOCKING_STACK_CHECK_LOCKED(stk)
+
+    while (stk->size == 0 && !stk->is_closed)
+    {
+        if (timeout_ms == 0)
+        {
+            pthread_mutex_unlock(&stk->sync->lock);
+            return STACK_ERROR_NOTHING_TO_POP;
+        }
+        if ( blocking_stack_wait_(stk, &stk->sync->not_empty, &stk->sync->poppers_waiting, timeout_ms, &deadline)
+          && stk->size == 0 && !stk->is_closed )
+        {
+            pthread_mutex_unlock(&stk->sync->lock);
+            return STACK_ERROR_TIMEOUT;
+        }
+    }
+    if (stk->size == 0)
+    {
+        pthread_mutex_unlock(&stk->sync->lock);
+        return STACK_ERROR_CLOSED;
+    }
+
+    stacksize_t count = (stk->size < max_count) ? stk->size : max_count;
+    for (stacksize_t ind = 0; ind < count; ind++)
+    {
+        ret_values[ind] = stk->data[stk->size - 1 - ind];
+#ifdef STACK_USE_POISON
+        fill_elem_with_poison_(stk->data + stk->size - 1 - ind);
+#endif
+    }
+    stk->size -= count;
+    *ret_count = count;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    blocking_stack_update_hash_(stk);
+#endif
+
+    long pushers_waiting = stk->sync->pushers_waiting;
+    pthread_mutex_unlock(&stk->sync->lock);
+
+    // one wake-up per freed slot at most, all of them at once if many slots are freed
+    if (pushers_waiting > 1 && count > 1)
+    {
+        pthread_cond_broadcast(&stk->sync->not_full);
+    }
+    else if (pushers_waiting > 0)
+    {
+        pthread_cond_signal(&stk->sync->not_full);
+    }
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode blocking_stack_pop_timed(BlockingStack *stk, Elem_t *ret_value, long timeout_ms)
+{
+    stacksize_t count = 0;
+
+    return blocking_stack_pop_batch(stk, ret_value, 1, &count, timeout_ms);
+}
+
+StackErrorCode blocking_stack_pop(BlockingStack *stk, Elem_t *ret_value)
+{
+    return blocking_stack_pop_timed(stk, ret_value, -1);
+}
+
+StackErrorCode blocking_stack_close(BlockingStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (!stk->sync) return STACK_ERROR_VERIFY;
+
+    pthread_mutex_lock(&stk->sync->lock);
+    BLOCKING_STACK_CHECK_LOCKED(stk)
+
+    stk->is_closed = 1;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    blocking_stack_update_hash_(stk);
+#endif
+    pthread_mutex_unlock(&stk->sync->lock);
+
+    pthread_cond_broadcast(&stk->sync->not_empty);
+    pthread_cond_broadcast(&stk->sync->not_full);
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+void blocking_stack_dump_(BlockingStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "BlockingStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "BlockingStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcapacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\tis_closed = <%d>\n"
+                    "\tsync[%p]\n"
+                    "\tdata[%p]\n", stk->size, stk->capacity, stk->is_closed, (void *) stk->sync, (void *) stk->data);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+                    "\thash_data = <" STACKHASH_T_SPECF ">\n", stk->hash_struct, stk->hash_data);
+#endif
+    if ( !(stk->data) || stk->capacity <= 0 )
+    {
+        fprintf(stderr, "Data pointer is NULL. Data cannot be accessed.\n");
+        return;
+    }
+
+    fprintf(stderr, "\t{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_left,
+                                                                        *(stk->p_data_canary_left));
+#endif
+    stacksize_t size = (0 <= stk->size && stk->size <= stk->capacity) ? stk->size : 0;
+    stacksize_t first = (size > 8) ? size - 8 : 0;
+    stacksize_t last = (size + 8 < stk->capacity) ? size + 8 : stk->capacity;
+    stack_dump_elems_(stderr, stk->data, size, stk->capacity, first, last, 1);
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_right,
+                                                                         *(stk->p_data_canary_right));
+#endif
+    fprintf(stderr, "\t}\n");
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // BLOCKING_STACK_H
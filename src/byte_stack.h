@@ -0,0 +1,644 @@
+#ifndef BYTE_STACK_H
+#define BYTE_STACK_H
+
+#include "stack.h"
+
+/*
+    Stack of variable-length records stored contiguously in one byte buffer. Every record is
+    followed by a trailer holding its length, so pop finds the beginning of the top record
+    without any index. Records start at addresses aligned by BYTE_STACK_RECORD_ALIGN, so a
+    span returned by peek can be cast to a struct pointer.
+
+    Record layout: [ payload | padding up to BYTE_STACK_RECORD_ALIGN | stacksize_t length ]
+
+    Spans returned by byte_stack_reserve() and byte_stack_peek() point into the buffer and
+    are valid only until the next push, commit, pop or drop.
+
+    USAGE:
+    ByteStack stk = {};
+    byte_stack_ctor(&stk);
+    byte_stack_push(&stk, "hello", 5);
+
+    void *span = NULL;
+    byte_stack_reserve(&stk, len, &span);   // zero-copy push:
+    memcpy(span, msg, len);                 //  write the payload in place,
+    byte_stack_commit(&stk, len);           //  then make it the top record
+
+    const void *top = NULL;
+    stacksize_t top_len = 0;
+    byte_stack_peek(&stk, &top, &top_len);  // zero-copy pop: look at the top record,
+    byte_stack_drop(&stk);                  //  then remove it
+*/
+
+const stacksize_t BYTE_STACK_RECORD_ALIGN = (stacksize_t) sizeof(stacksize_t);
+const stacksize_t BYTE_STACK_MIN_CAPACITY = 64;
+
+#ifdef STACK_DO_DUMP
+const stacksize_t BYTE_STACK_DUMP_MAX_RECORDS = 16;
+const stacksize_t BYTE_STACK_DUMP_MAX_BYTES = 32;
+#endif
+
+struct ByteStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    char *data = NULL;
+    stacksize_t size = -1;      //< Количество занятых байт, вместе с длинами и выравниванием.
+    stacksize_t capacity = -1;  //< Размер буфера в байтах.
+    stacksize_t records = -1;   //< Количество записей в стеке.
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+    void *p_origin = NULL;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t* p_data_canary_left = NULL;
+    canary_t* p_data_canary_right = NULL;
+
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks byte stack's condition, including the length trailer of the top record.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int byte_stack_verify(ByteStack *stk);
+
+//! @brief Byte stack constructor. ONLY FOR INTERNAL USE! USE MACRO byte_stack_ctor()!
+//! @details It doesn't allocate memory, first push() will do it.
+//! @param [in] stk Pointer to stack to construct.
+//! @return StackErrorCode enum value.
+StackErrorCode byte_stack_ctor_( ByteStack *stk
+#ifdef STACK_DO_DUMP
+                                 ,
+                                 const char *stack_name,
+                                 const char *orig_file_name,
+                                 const int orig_line,
+                                 const char *orig_func_name
+#endif
+                               );
+
+//! @brief Byte stack deconstructor.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode byte_stack_dtor(ByteStack *stk);
+
+//! @brief Copies len bytes from bytes to the new top record.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] bytes Payload of the record, may be NULL if len is 0.
+//! @param [in] len Length of the payload.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if len is negative,
+//! or if bytes is NULL and len is positive.
+static StackErrorCode byte_stack_push(ByteStack *stk, const void *bytes, stacksize_t len);
+
+//! @brief Makes room for a record of len bytes above the top and returns it, so the payload
+//! can be written in place. The record is pushed only by byte_stack_commit().
+//! @param [in] stk Pointer to the stack.
+//! @param [in] len Length of the payload.
+//! @param [out] span Pointer to put the address of the room to.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if len is negative.
+static StackErrorCode byte_stack_reserve(ByteStack *stk, stacksize_t len, void **span);
+
+//! @brief Pushes the record of len bytes written to the span returned by byte_stack_reserve().
+//! @param [in] stk Pointer to the stack.
+//! @param [in] len Length of the payload, must not exceed the one passed to byte_stack_reserve().
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if len is negative.
+static StackErrorCode byte_stack_commit(ByteStack *stk, stacksize_t len);
+
+//! @brief Returns the top record without copying it.
+//! @param [in] stk Pointer to the stack.
+//! @param [out] span Pointer to put the address of the payload to.
+//! @param [out] len Pointer to put the length of the payload to.
+//! @return StackErrorCode enum value.
+static StackErrorCode byte_stack_peek(ByteStack *stk, const void **span, stacksize_t *len);
+
+//! @brief Removes the top record without copying it.
+//! @param [in] stk Pointer to the stack.
+//! @return StackErrorCode enum value.
+static StackErrorCode byte_stack_drop(ByteStack *stk);
+
+//! @brief Copies the top record to buf and removes it from the stack.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] buf Buffer to put the payload to.
+//! @param [in] buf_size Size of buf, STACK_ERROR_OVERFLOW is returned if the payload doesn't fit.
+//! @param [out] len Pointer to put the length of the payload to.
+//! @return StackErrorCode enum value.
+static StackErrorCode byte_stack_pop(ByteStack *stk, void *buf, stacksize_t buf_size, stacksize_t *len);
+
+//! @brief Reallocs the buffer so that it can hold need bytes, or shrinks it if it is mostly empty.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] need Number of bytes the buffer must be able to hold.
+//! @return StackErrorCode enum value.
+static StackErrorCode byte_stack_realloc(ByteStack *stk, stacksize_t need);
+
+#ifndef STACK_DO_DUMP
+
+#define BYTE_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define BYTE_STACK_DUMP(stk, verify_res) byte_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void byte_stack_dump_(ByteStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//-----------------------------------BYTE_STACK.CPP-------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define BYTE_STACK_CHECK(stk)    {                  \
+    int verify_res = byte_stack_verify(stk);        \
+    if ( verify_res != 0 ) {                        \
+        BYTE_STACK_DUMP(stk, verify_res);           \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+//! @brief Returns the number of bytes taken by the record with payload of len bytes.
+inline stacksize_t byte_stack_record_size_(stacksize_t len)
+{
+    stacksize_t padded = (len + BYTE_STACK_RECORD_ALIGN - 1) / BYTE_STACK_RECORD_ALIGN * BYTE_STACK_RECORD_ALIGN;
+
+    return padded + (stacksize_t) sizeof(stacksize_t);
+}
+
+//! @brief Reads the length trailer which ends at byte end of the buffer.
+inline stacksize_t byte_stack_trailer_(const ByteStack *stk, stacksize_t end)
+{
+    stacksize_t len = 0;
+    memcpy(&len, stk->data + end - (stacksize_t) sizeof(stacksize_t), sizeof(len));
+
+    return len;
+}
+
+//! @brief Checks that the record ending at byte end has a sane trailer.
+inline int byte_stack_is_record_valid_(const ByteStack *stk, stacksize_t end)
+{
+    if ( end < (stacksize_t) sizeof(stacksize_t) ) return 0;
+
+    stacksize_t len = byte_stack_trailer_(stk, end);
+
+    return len >= 0 && len <= end && byte_stack_record_size_(len) <= end;
+}
+
+#ifdef STACK_USE_POISON
+inline void byte_stack_fill_with_poison_(ByteStack *stk, stacksize_t first, stacksize_t last)
+{
+    assert(stk);
+
+    if (first < last) memset(stk->data + first, POISON_VALUE, (size_t) (last - first));
+}
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t byte_stack_compute_hash_data_(ByteStack *stk)
+{
+    assert(stk);
+
+    return stack_compute_hash( stk->data, (unsigned int) stk->size );
+}
+
+inline stackhash_t byte_stack_compute_hash_struct_(ByteStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+inline void byte_stack_update_hash_(ByteStack *stk)
+{
+    assert(stk);
+
+    stk->hash_data = (stk->data) ? byte_stack_compute_hash_data_(stk) : HASH_DEFAULT_VALUE;
+    stk->hash_struct = byte_stack_compute_hash_struct_(stk);
+}
+#endif
+
+int byte_stack_verify(ByteStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( !(stk->data) && (stk->size != 0 || stk->capacity != 0) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( stk->size < 0 || stk->size > stk->capacity || stk->records < 0 || (stk->records == 0) != (stk->size == 0) )
+    error |= STACK_VERIFY_SIZE_INVALID;
+    else if ( stk->data && stk->size > 0 && !byte_stack_is_record_valid_(stk, stk->size) )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+    if ( stk->capacity < 0 )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( stk->data && ( *(stk->p_data_canary_left) != CANARY_LEFT_DEFAULT_VALUE
+                     || *(stk->p_data_canary_right) != CANARY_RIGHT_DEFAULT_VALUE ) )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != byte_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->data && !(error & STACK_VERIFY_SIZE_INVALID) && stk->hash_data != byte_stack_compute_hash_data_(stk) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define byte_stack_ctor(stk) byte_stack_ctor_(stk, #stk, __FILE__, __LINE__, __func__)
+#else
+#define byte_stack_ctor(stk) byte_stack_ctor_(stk)
+#endif
+
+StackErrorCode byte_stack_ctor_( ByteStack *stk
+#ifdef STACK_DO_DUMP
+                                 ,
+                                 const char *stack_name,
+                                 const char *orig_file_name,
+                                 const int orig_line,
+                                 const char *orig_func_name
+#endif
+                               )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    byte_stack_dtor(stk);
+
+    stk->data = NULL;
+    stk->p_origin = NULL;
+    stk->capacity = 0;
+    stk->size = 0;
+    stk->records = 0;
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    byte_stack_update_hash_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_dtor(ByteStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    stk->capacity = -1;
+    stk->size = -1;
+    stk->records = -1;
+    if (stk->p_origin) free(stk->p_origin);
+    stk->p_origin = NULL;
+    stk->data = NULL;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+
+    stk->p_data_canary_left = NULL;
+    stk->p_data_canary_right = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stk->hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_reserve(ByteStack *stk, stacksize_t len, void **span)
+{
+    BYTE_STACK_CHECK(stk)
+    if ( !span ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if ( len < 0 ) return STACK_ERROR_BAD_ARG;
+
+    StackErrorCode mem_realloc_res = byte_stack_realloc(stk, stk->size + byte_stack_record_size_(len));
+    if ( mem_realloc_res )
+    {
+        return mem_realloc_res;
+    }
+
+    *span = stk->data + stk->size;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_commit(ByteStack *stk, stacksize_t len)
+{
+    BYTE_STACK_CHECK(stk)
+    if ( len < 0 ) return STACK_ERROR_BAD_ARG;
+
+    stacksize_t new_size = stk->size + byte_stack_record_size_(len);
+    if ( new_size > stk->capacity ) return STACK_ERROR_OVERFLOW;
+
+    stacksize_t padded_end = new_size - (stacksize_t) sizeof(stacksize_t);
+#ifdef STACK_USE_POISON
+    byte_stack_fill_with_poison_(stk, stk->size + len, padded_end);
+#else
+    memset(stk->data + stk->size + len, 0, (size_t) (padded_end - stk->size - len));
+#endif
+    memcpy(stk->data + padded_end, &len, sizeof(len));
+
+    stk->size = new_size;
+    stk->records++;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    byte_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_push(ByteStack *stk, const void *bytes, stacksize_t len)
+{
+    if ( len > 0 && !bytes ) return STACK_ERROR_BAD_ARG;
+
+    void *span = NULL;
+    StackErrorCode reserve_res = byte_stack_reserve(stk, len, &span);
+    if ( reserve_res )
+    {
+        return reserve_res;
+    }
+
+    if (len > 0) memcpy(span, bytes, (size_t) len);
+
+    return byte_stack_commit(stk, len);
+}
+
+StackErrorCode byte_stack_peek(ByteStack *stk, const void **span, stacksize_t *len)
+{
+    BYTE_STACK_CHECK(stk)
+    if ( !span || !len ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    if (stk->records == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        BYTE_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    *len = byte_stack_trailer_(stk, stk->size);
+    *span = stk->data + stk->size - byte_stack_record_size_(*len);
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_drop(ByteStack *stk)
+{
+    BYTE_STACK_CHECK(stk)
+
+    if (stk->records == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        BYTE_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    stacksize_t new_size = stk->size - byte_stack_record_size_( byte_stack_trailer_(stk, stk->size) );
+
+#ifdef STACK_USE_POISON
+    byte_stack_fill_with_poison_(stk, new_size, stk->size);
+#endif
+
+    stk->size = new_size;
+    stk->records--;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    byte_stack_update_hash_(stk);
+#endif
+
+    // the record is already dropped, and a failed shrink keeps the old buffer, which still fits it
+    byte_stack_realloc(stk, stk->size);
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_pop(ByteStack *stk, void *buf, stacksize_t buf_size, stacksize_t *len)
+{
+    if ( !buf || !len ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    const void *span = NULL;
+    stacksize_t top_len = 0;
+    StackErrorCode peek_res = byte_stack_peek(stk, &span, &top_len);
+    if ( peek_res )
+    {
+        return peek_res;
+    }
+
+    *len = top_len;
+    if (top_len > buf_size) return STACK_ERROR_OVERFLOW;
+
+    memcpy(buf, span, (size_t) top_len);
+
+    return byte_stack_drop(stk);
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+//! @brief Allocates buffer of new_capacity bytes, copies the records to it, frees old buffer.
+inline StackErrorCode byte_stack_realloc_to_(ByteStack *stk, stacksize_t new_capacity)
+{
+    assert(stk);
+    assert(new_capacity >= stk->size);
+
+    void *p_new_origin = calloc( stack_data_block_size_((size_t) new_capacity, (size_t) BYTE_STACK_RECORD_ALIGN), 1 );
+    if (!p_new_origin) return STACK_ERROR_MEM_BAD_REALLOC;
+
+    char *new_data = stack_place_data_( p_new_origin, (size_t) new_capacity, (size_t) BYTE_STACK_RECORD_ALIGN
+#ifdef STACK_USE_PROTECTION_CANARY
+                                        , &stk->p_data_canary_left, &stk->p_data_canary_right
+#endif
+                                      );
+
+    if (stk->size > 0)
+    {
+        memcpy(new_data, stk->data, (size_t) stk->size);
+    }
+
+    if (stk->p_origin) free(stk->p_origin);
+
+    stk->data = new_data;
+    stk->p_origin = p_new_origin;
+    stk->capacity = new_capacity;
+
+#ifdef STACK_USE_POISON
+    byte_stack_fill_with_poison_(stk, stk->size, stk->capacity);
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    byte_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode byte_stack_realloc(ByteStack *stk, stacksize_t need)
+{
+    BYTE_STACK_CHECK(stk)
+
+    const int MEM_MULTIPLIER = 2;
+
+    if ( need > stk->capacity )
+    {
+        stacksize_t new_capacity = (stk->capacity == 0) ? BYTE_STACK_MIN_CAPACITY : stk->capacity;
+        while (new_capacity < need)
+        {
+            new_capacity *= MEM_MULTIPLIER;
+        }
+        return byte_stack_realloc_to_(stk, new_capacity);
+    }
+    else if ( stk->capacity > BYTE_STACK_MIN_CAPACITY && need * ( MEM_MULTIPLIER * MEM_MULTIPLIER ) <= stk->capacity )
+    {
+        return byte_stack_realloc_to_(stk, stk->capacity / MEM_MULTIPLIER);
+    }
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+//! @brief Prints at most BYTE_STACK_DUMP_MAX_RECORDS records from the top, walking their trailers
+//! while they are sane, and at most BYTE_STACK_DUMP_MAX_BYTES bytes of each payload in hex.
+inline void byte_stack_dump_data_( ByteStack *stk )
+{
+    fprintf(stderr, "\t{\n");
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_left,
+                                                                        *(stk->p_data_canary_left));
+#endif
+
+    stacksize_t end = (0 <= stk->size && stk->size <= stk->capacity) ? stk->size : 0;
+    stacksize_t printed = 0;
+    while ( end > 0 && printed < BYTE_STACK_DUMP_MAX_RECORDS )
+    {
+        if ( !byte_stack_is_record_valid_(stk, end) )
+        {
+            fprintf(stderr, "\t\tRecord ending at byte " STACKSIZE_T_SPECF " has damaged length trailer.\n", end);
+            break;
+        }
+
+        stacksize_t len = byte_stack_trailer_(stk, end);
+        stacksize_t start = end - byte_stack_record_size_(len);
+
+        fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "][%p] len = " STACKSIZE_T_SPECF "\t = <",
+                start, (void *)(stk->data + start), len);
+        for (stacksize_t ind = 0; ind < len && ind < BYTE_STACK_DUMP_MAX_BYTES; ind++)
+        {
+            fprintf(stderr, "%02X", (unsigned char) stk->data[start + ind]);
+        }
+        fputs((len > BYTE_STACK_DUMP_MAX_BYTES) ? "...>" : ">", stderr);
+
+        if (printed == 0) fprintf(stderr, " <-- top");
+        fprintf(stderr, "\n");
+
+        end = start;
+        printed++;
+    }
+
+    if (end > 0 && printed == BYTE_STACK_DUMP_MAX_RECORDS)
+    {
+        fprintf(stderr, "\t\t... " STACKSIZE_T_SPECF " more records in bytes [0.." STACKSIZE_T_SPECF ")\n",
+                stk->records - printed, end);
+    }
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_right,
+                                                                         *(stk->p_data_canary_right));
+#endif
+
+    fprintf(stderr, "\t}\n");
+}
+
+void byte_stack_dump_(ByteStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "ByteStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "ByteStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcapacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\trecords = <" STACKSIZE_T_SPECF ">\n"
+                    "\tdata[%p]\n", stk->size, stk->capacity, stk->records, (void *) stk->data);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+                    "\thash_data = <" STACKHASH_T_SPECF ">\n", stk->hash_struct, stk->hash_data);
+#endif
+    if ( !(stk->data) )
+    {
+        fprintf(stderr, "Data pointer is NULL. Data cannot be accessed.\n");
+        return;
+    }
+
+    byte_stack_dump_data_(stk);
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // BYTE_STACK_H
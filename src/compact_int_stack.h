@@ -0,0 +1,536 @@
+#ifndef COMPACT_INT_STACK_H
+#define COMPACT_INT_STACK_H
+
+#include <stdint.h>
+
+#include "byte_stack.h"
+
+/*
+    Stack of 64-bit integers compressed by blocks of COMPACT_INT_STACK_BLOCK_ELEMS values with
+    frame of reference: a full block is stored as its minimum and the differences from it,
+    each in the smallest number of bits which fits the largest difference. Small or close
+    values (counters, indices, operands) take a few bits each instead of 64.
+
+    Only the top block is kept decoded, in the struct itself. Push encodes it when it is full,
+    pop decodes the next one when it is empty, so every value is encoded and decoded at most
+    once on the way up and down. Encoded blocks are records of ByteStack, which gives them
+    its growth, canaries and hash.
+
+    USAGE:
+    CompactIntStack stk = {};
+    compact_int_stack_ctor(&stk);
+    compact_int_stack_push(&stk, 42);
+    compact_int_stack_pop(&stk, &value);
+*/
+
+const int COMPACT_INT_STACK_BLOCK_ELEMS = 64;
+
+#ifdef STACK_DO_DUMP
+const stacksize_t COMPACT_INT_STACK_DUMP_MAX_BLOCKS = 8;
+#endif
+
+//! @brief Beginning of every encoded block, followed by bits words of packed differences.
+struct CompactIntBlockHeader
+{
+    int64_t base;
+    int64_t bits;
+};
+
+struct CompactIntStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    ByteStack blocks = {};      //< Закодированные блоки, кроме верхнего.
+    stacksize_t size = -1;
+    int top_size = -1;          //< Количество значений в раскодированном верхнем блоке.
+    int64_t top[COMPACT_INT_STACK_BLOCK_ELEMS] = {};
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks compact int stack's condition, together with the stack of its encoded blocks.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int compact_int_stack_verify(CompactIntStack *stk);
+
+//! @brief Compact int stack constructor. ONLY FOR INTERNAL USE! USE MACRO compact_int_stack_ctor()!
+//! @param [in] stk Pointer to stack to construct.
+//! @return StackErrorCode enum value.
+StackErrorCode compact_int_stack_ctor_( CompactIntStack *stk
+#ifdef STACK_DO_DUMP
+                                        ,
+                                        const char *stack_name,
+                                        const char *orig_file_name,
+                                        const int orig_line,
+                                        const char *orig_func_name
+#endif
+                                      );
+
+//! @brief Compact int stack deconstructor.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode compact_int_stack_dtor(CompactIntStack *stk);
+
+//! @brief Pushes value to the stack, encoding the top block if it is full.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push.
+//! @return StackErrorCode enum value.
+static StackErrorCode compact_int_stack_push(CompactIntStack *stk, int64_t value);
+
+//! @brief Pops value from the stack, decoding the next block if the top one is empty.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value.
+static StackErrorCode compact_int_stack_pop(CompactIntStack *stk, int64_t *ret_value);
+
+//! @brief Returns the number of bytes taken by the stack, its buffers included.
+//! @param [in] stk Pointer to the stack.
+//! @return Number of bytes.
+static size_t compact_int_stack_memory(const CompactIntStack *stk);
+
+#ifndef STACK_DO_DUMP
+
+#define COMPACT_INT_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define COMPACT_INT_STACK_DUMP(stk, verify_res) compact_int_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void compact_int_stack_dump_(CompactIntStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------COMPACT_INT_STACK.CPP---------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define COMPACT_INT_STACK_CHECK(stk)    {           \
+    int verify_res = compact_int_stack_verify(stk); \
+    if ( verify_res != 0 ) {                        \
+        COMPACT_INT_STACK_DUMP(stk, verify_res);    \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t compact_int_stack_compute_hash_struct_(CompactIntStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+#endif
+
+int compact_int_stack_verify(CompactIntStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = byte_stack_verify(&stk->blocks);
+
+    if ( stk->top_size < 0 || stk->top_size > COMPACT_INT_STACK_BLOCK_ELEMS
+      || stk->size != stk->blocks.records * COMPACT_INT_STACK_BLOCK_ELEMS + stk->top_size )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != compact_int_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//! @brief Returns the size of the encoded block whose differences take bits bits.
+inline stacksize_t compact_int_stack_block_size_(int64_t bits)
+{
+    return (stacksize_t) ( sizeof(CompactIntBlockHeader) + (size_t) bits*sizeof(uint64_t) );
+}
+
+//! @brief Encodes full top block to block, which must have room for 64 bits per value.
+//! @return Size of the encoded block in bytes.
+inline stacksize_t compact_int_stack_encode_(const int64_t *values, char *block)
+{
+    int64_t base = values[0];
+    for (int ind = 1; ind < COMPACT_INT_STACK_BLOCK_ELEMS; ind++)
+    {
+        if (values[ind] < base) base = values[ind];
+    }
+
+    uint64_t max_diff = 0;
+    for (int ind = 0; ind < COMPACT_INT_STACK_BLOCK_ELEMS; ind++)
+    {
+        max_diff |= (uint64_t) values[ind] - (uint64_t) base;
+    }
+
+    int bits = 0;
+    while (bits < 64 && (max_diff >> bits) != 0) bits++;
+
+    CompactIntBlockHeader *header = (CompactIntBlockHeader *) block;
+    header->base = base;
+    header->bits = bits;
+
+    uint64_t *words = (uint64_t *) (block + sizeof(CompactIntBlockHeader));
+    memset(words, 0, (size_t) bits*sizeof(uint64_t));
+
+    // COMPACT_INT_STACK_BLOCK_ELEMS == 64, so the differences take exactly bits words
+    for (int ind = 0; ind < COMPACT_INT_STACK_BLOCK_ELEMS && bits > 0; ind++)
+    {
+        uint64_t diff = (uint64_t) values[ind] - (uint64_t) base;
+        int bit_pos = ind * bits;
+        int word = bit_pos / 64;
+        int shift = bit_pos % 64;
+
+        words[word] |= diff << shift;
+        if (shift + bits > 64)
+        {
+            words[word + 1] |= diff >> (64 - shift);
+        }
+    }
+
+    return compact_int_stack_block_size_(bits);
+}
+
+//! @brief Decodes block to full top block.
+inline void compact_int_stack_decode_(const char *block, int64_t *values)
+{
+    const CompactIntBlockHeader *header = (const CompactIntBlockHeader *) block;
+    const uint64_t *words = (const uint64_t *) (block + sizeof(CompactIntBlockHeader));
+    int bits = (int) header->bits;
+    uint64_t mask = (bits >= 64) ? ~(uint64_t) 0 : ( ((uint64_t) 1 << bits) - 1 );
+
+    for (int ind = 0; ind < COMPACT_INT_STACK_BLOCK_ELEMS; ind++)
+    {
+        uint64_t diff = 0;
+        if (bits > 0)
+        {
+            int bit_pos = ind * bits;
+            int word = bit_pos / 64;
+            int shift = bit_pos % 64;
+
+            diff = words[word] >> shift;
+            if (shift + bits > 64)
+            {
+                diff |= words[word + 1] << (64 - shift);
+            }
+        }
+
+        values[ind] = (int64_t) ( (uint64_t) header->base + (diff & mask) );
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define compact_int_stack_ctor(stk) compact_int_stack_ctor_(stk, #stk, __FILE__, __LINE__, __func__)
+#else
+#define compact_int_stack_ctor(stk) compact_int_stack_ctor_(stk)
+#endif
+
+StackErrorCode compact_int_stack_ctor_( CompactIntStack *stk
+#ifdef STACK_DO_DUMP
+                                        ,
+                                        const char *stack_name,
+                                        const char *orig_file_name,
+                                        const int orig_line,
+                                        const char *orig_func_name
+#endif
+                                      )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    compact_int_stack_dtor(stk);
+
+    StackErrorCode blocks_ctor_res = byte_stack_ctor_( &stk->blocks
+#ifdef STACK_DO_DUMP
+                                                       , stack_name, orig_file_name, orig_line, orig_func_name
+#endif
+                                                     );
+    if ( blocks_ctor_res )
+    {
+        return blocks_ctor_res;
+    }
+
+    stk->size = 0;
+    stk->top_size = 0;
+#ifdef STACK_USE_POISON
+    memset(stk->top, POISON_VALUE, sizeof(stk->top));
+#endif
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = compact_int_stack_compute_hash_struct_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode compact_int_stack_dtor(CompactIntStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    byte_stack_dtor(&stk->blocks);
+    stk->size = -1;
+    stk->top_size = -1;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode compact_int_stack_push(CompactIntStack *stk, int64_t value)
+{
+    COMPACT_INT_STACK_CHECK(stk)
+
+    if (stk->top_size == COMPACT_INT_STACK_BLOCK_ELEMS)
+    {
+        void *span = NULL;
+        StackErrorCode reserve_res = byte_stack_reserve( &stk->blocks, compact_int_stack_block_size_(64), &span );
+        if ( reserve_res )
+        {
+            return reserve_res;
+        }
+
+        stacksize_t block_size = compact_int_stack_encode_(stk->top, (char *) span);
+
+        StackErrorCode commit_res = byte_stack_commit(&stk->blocks, block_size);
+        if ( commit_res )
+        {
+            return commit_res;
+        }
+
+        stk->top_size = 0;
+#ifdef STACK_USE_POISON
+        memset(stk->top, POISON_VALUE, sizeof(stk->top));
+#endif
+    }
+
+    stk->top[(stk->top_size)++] = value;
+    stk->size++;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = compact_int_stack_compute_hash_struct_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode compact_int_stack_pop(CompactIntStack *stk, int64_t *ret_value)
+{
+    COMPACT_INT_STACK_CHECK(stk)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    if (stk->size == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        COMPACT_INT_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    if (stk->top_size == 0)
+    {
+        const void *span = NULL;
+        stacksize_t block_size = 0;
+        StackErrorCode peek_res = byte_stack_peek(&stk->blocks, &span, &block_size);
+        if ( peek_res )
+        {
+            return peek_res;
+        }
+
+        const CompactIntBlockHeader *header = (const CompactIntBlockHeader *) span;
+        if ( block_size < (stacksize_t) sizeof(CompactIntBlockHeader) || header->bits < 0 || header->bits > 64
+          || block_size != compact_int_stack_block_size_(header->bits) )
+        {
+            COMPACT_INT_STACK_DUMP(stk, STACK_VERIFY_SIZE_INVALID);
+            return STACK_ERROR_VERIFY;
+        }
+
+        // the drop may poison or free the record, so it is decoded aside first; the drop fails
+        // only before it removes the record, so then the stack stays as it was
+        int64_t block[COMPACT_INT_STACK_BLOCK_ELEMS] = {};
+        compact_int_stack_decode_( (const char *) span, block );
+
+        StackErrorCode drop_res = byte_stack_drop(&stk->blocks);
+        if ( drop_res )
+        {
+            return drop_res;
+        }
+
+        memcpy(stk->top, block, sizeof(stk->top));
+        stk->top_size = COMPACT_INT_STACK_BLOCK_ELEMS;
+    }
+
+    *ret_value = stk->top[--(stk->top_size)];
+    stk->size--;
+
+#ifdef STACK_USE_POISON
+    memset(stk->top + stk->top_size, POISON_VALUE, sizeof(stk->top[0]));
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = compact_int_stack_compute_hash_struct_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+size_t compact_int_stack_memory(const CompactIntStack *stk)
+{
+    if (!stk) return 0;
+
+    size_t memory = sizeof(*stk);
+    if (stk->blocks.capacity > 0)
+    {
+        memory += stack_data_block_size_( (size_t) stk->blocks.capacity, (size_t) BYTE_STACK_RECORD_ALIGN );
+    }
+
+    return memory;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+//! @brief Prints values of the top block and headers of at most COMPACT_INT_STACK_DUMP_MAX_BLOCKS encoded blocks.
+inline void compact_int_stack_dump_data_( CompactIntStack *stk )
+{
+    fprintf(stderr, "\t{\n");
+
+    fprintf(stderr, "\tTop block:\n");
+    for (int ind = 0; ind < COMPACT_INT_STACK_BLOCK_ELEMS; ind++)
+    {
+        fprintf(stderr, "\t\t[%d] = <%lld>", ind, (long long) stk->top[ind]);
+
+#ifdef STACK_USE_POISON
+        if (ind >= stk->top_size) fprintf(stderr, " (MAYBE POISON)");
+#endif
+
+        if (ind == stk->top_size) fprintf(stderr, " <--");
+        fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "\tEncoded blocks: " STACKSIZE_T_SPECF ", " STACKSIZE_T_SPECF " bytes\n",
+            stk->blocks.records, stk->blocks.size);
+
+    stacksize_t end = (0 <= stk->blocks.size && stk->blocks.size <= stk->blocks.capacity) ? stk->blocks.size : 0;
+    stacksize_t printed = 0;
+    while ( stk->blocks.data && end > 0 && printed < COMPACT_INT_STACK_DUMP_MAX_BLOCKS )
+    {
+        if ( !byte_stack_is_record_valid_(&stk->blocks, end) )
+        {
+            fprintf(stderr, "\t\tBlock ending at byte " STACKSIZE_T_SPECF " has damaged length trailer.\n", end);
+            break;
+        }
+
+        stacksize_t len = byte_stack_trailer_(&stk->blocks, end);
+        stacksize_t start = end - byte_stack_record_size_(len);
+
+        if ( len >= (stacksize_t) sizeof(CompactIntBlockHeader) )
+        {
+            const CompactIntBlockHeader *header = (const CompactIntBlockHeader *) (stk->blocks.data + start);
+            fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "] base = <%lld>, bits = <%lld>, len = " STACKSIZE_T_SPECF "\n",
+                    start, (long long) header->base, (long long) header->bits, len);
+        }
+        else
+        {
+            fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "] too short block, len = " STACKSIZE_T_SPECF "\n", start, len);
+        }
+
+        end = start;
+        printed++;
+    }
+
+    if (end > 0 && printed == COMPACT_INT_STACK_DUMP_MAX_BLOCKS)
+    {
+        fprintf(stderr, "\t\t... " STACKSIZE_T_SPECF " more blocks\n", stk->blocks.records - printed);
+    }
+
+    fprintf(stderr, "\t}\n");
+}
+
+void compact_int_stack_dump_(CompactIntStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "CompactIntStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "CompactIntStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\ttop_size = <%d>\n", stk->size, stk->top_size);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n", stk->hash_struct);
+#endif
+
+    compact_int_stack_dump_data_(stk);
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // COMPACT_INT_STACK_H
@@ -0,0 +1,487 @@
+#ifndef DOUBLE_STACK_H
+#define DOUBLE_STACK_H
+
+#include "stack.h"
+
+/*
+    Two stacks growing toward each other from the ends of a single buffer: the left one from
+    data[0] up, the right one from data[capacity - 1] down. Memory is reallocated only when
+    their tops meet, so the buffer is used fully. One pair of data canaries and one data hash
+    cover both stacks.
+
+    USAGE:
+    DoubleStack stk = {};
+    double_stack_ctor(&stk);
+    double_stack_push(&stk, DOUBLE_STACK_LEFT, value);
+    double_stack_pop(&stk, DOUBLE_STACK_RIGHT, &value);
+*/
+
+//! @brief Selects one of the two stacks in DoubleStack.
+enum DoubleStackSide
+{
+    DOUBLE_STACK_LEFT   = 0, //< Stack growing from the beginning of the buffer.
+    DOUBLE_STACK_RIGHT  = 1, //< Stack growing from the end of the buffer.
+};
+
+struct DoubleStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    Elem_t *data = NULL;
+    stacksize_t size_left = -1;
+    stacksize_t size_right = -1;
+    stacksize_t capacity = -1;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+    void *p_origin = NULL;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t* p_data_canary_left = NULL;
+    canary_t* p_data_canary_right = NULL;
+
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks double stack's condition.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int double_stack_verify(DoubleStack *stk);
+
+//! @brief Double stack constructor. ONLY FOR INTERNAL USE! USE MACRO double_stack_ctor()!
+//! @details It doesn't allocate memory, first push() will do it.
+//! @param [in] stk Pointer to stack to construct.
+//! @return StackErrorCode enum value.
+StackErrorCode double_stack_ctor_( DoubleStack *stk
+#ifdef STACK_DO_DUMP
+                                   ,
+                                   const char *stack_name,
+                                   const char *orig_file_name,
+                                   const int orig_line,
+                                   const char *orig_func_name
+#endif
+                                 );
+
+//! @brief Double stack deconstructor.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode double_stack_dtor(DoubleStack *stk);
+
+//! @brief Pushes element to one of the stacks.
+//! @param [in] stk Pointer to the double stack.
+//! @param [in] side Stack to push to.
+//! @param [in] value Value to push.
+//! @return StackErrorCode enum value.
+static StackErrorCode double_stack_push(DoubleStack *stk, DoubleStackSide side, Elem_t value);
+
+//! @brief Pops element from one of the stacks.
+//! @param [in] stk Pointer to the double stack.
+//! @param [in] side Stack to pop from.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value.
+static StackErrorCode double_stack_pop(DoubleStack *stk, DoubleStackSide side, Elem_t *ret_value);
+
+//! @brief Reallocs the buffer if the tops have met or if it is mostly empty.
+//! @param [in] stk Pointer to the double stack.
+//! @return StackErrorCode enum value.
+static StackErrorCode double_stack_realloc(DoubleStack *stk);
+
+#ifndef STACK_DO_DUMP
+
+#define DOUBLE_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define DOUBLE_STACK_DUMP(stk, verify_res) double_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void double_stack_dump_(DoubleStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//----------------------------------DOUBLE_STACK.CPP------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define DOUBLE_STACK_CHECK(stk)    {                \
+    int verify_res = double_stack_verify(stk);      \
+    if ( verify_res != 0 ) {                        \
+        DOUBLE_STACK_DUMP(stk, verify_res);         \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t double_stack_compute_hash_data_(DoubleStack *stk)
+{
+    assert(stk);
+
+    return stack_compute_hash( (char *) stk->data, (unsigned int) ((size_t) stk->capacity*sizeof(Elem_t)) );
+}
+
+inline stackhash_t double_stack_compute_hash_struct_(DoubleStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+inline void double_stack_update_hash_(DoubleStack *stk)
+{
+    assert(stk);
+
+    stk->hash_data = (stk->data) ? double_stack_compute_hash_data_(stk) : HASH_DEFAULT_VALUE;
+    stk->hash_struct = double_stack_compute_hash_struct_(stk);
+}
+#endif
+
+int double_stack_verify(DoubleStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( !(stk->data) && (stk->size_left != 0 || stk->size_right != 0 || stk->capacity != 0) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( stk->size_left < 0 || stk->size_right < 0 || stk->size_left + stk->size_right > stk->capacity )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+    if ( stk->capacity < 0 )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( stk->data && ( *(stk->p_data_canary_left) != CANARY_LEFT_DEFAULT_VALUE
+                     || *(stk->p_data_canary_right) != CANARY_RIGHT_DEFAULT_VALUE ) )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != double_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->data && stk->hash_data != double_stack_compute_hash_data_(stk) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define double_stack_ctor(stk) double_stack_ctor_(stk, #stk, __FILE__, __LINE__, __func__)
+#else
+#define double_stack_ctor(stk) double_stack_ctor_(stk)
+#endif
+
+StackErrorCode double_stack_ctor_( DoubleStack *stk
+#ifdef STACK_DO_DUMP
+                                   ,
+                                   const char *stack_name,
+                                   const char *orig_file_name,
+                                   const int orig_line,
+                                   const char *orig_func_name
+#endif
+                                 )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    double_stack_dtor(stk);
+
+    stk->data = NULL;
+    stk->p_origin = NULL;
+    stk->capacity = 0;
+    stk->size_left = 0;
+    stk->size_right = 0;
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    double_stack_update_hash_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode double_stack_dtor(DoubleStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    stk->capacity = -1;
+    stk->size_left = -1;
+    stk->size_right = -1;
+    if (stk->p_origin) free(stk->p_origin);
+    stk->p_origin = NULL;
+    stk->data = NULL;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+
+    stk->p_data_canary_left = NULL;
+    stk->p_data_canary_right = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stk->hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode double_stack_push(DoubleStack *stk, DoubleStackSide side, Elem_t value)
+{
+    DOUBLE_STACK_CHECK(stk)
+
+    StackErrorCode mem_realloc_res = double_stack_realloc(stk);
+    if ( mem_realloc_res )
+    {
+        return mem_realloc_res;
+    }
+
+    if (side == DOUBLE_STACK_LEFT)
+    {
+        (stk->data)[(stk->size_left)++] = value;
+    }
+    else
+    {
+        (stk->data)[stk->capacity - ++(stk->size_right)] = value;
+    }
+
+#ifdef STACK_USE_PROTECTION_HASH
+    double_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode double_stack_pop(DoubleStack *stk, DoubleStackSide side, Elem_t *ret_value)
+{
+    DOUBLE_STACK_CHECK(stk)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    stacksize_t *p_size = (side == DOUBLE_STACK_LEFT) ? &stk->size_left : &stk->size_right;
+    if (*p_size == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        DOUBLE_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    --(*p_size);
+    stacksize_t ind = (side == DOUBLE_STACK_LEFT) ? stk->size_left : stk->capacity - stk->size_right - 1;
+    *ret_value = stk->data[ind];
+
+#ifdef STACK_USE_POISON
+    fill_elem_with_poison_(stk->data + ind);
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    double_stack_update_hash_(stk);
+#endif
+
+    StackErrorCode mem_realloc_res = double_stack_realloc(stk);
+    if ( mem_realloc_res )
+    {
+        return mem_realloc_res;
+    }
+
+#ifdef STACK_USE_PROTECTION_HASH
+    double_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+//! @brief Allocates buffer of new_capacity elements, moves the left stack to its beginning
+//! and the right stack to its end, frees old buffer.
+inline StackErrorCode double_stack_realloc_to_(DoubleStack *stk, stacksize_t new_capacity)
+{
+    assert(stk);
+    assert(new_capacity >= stk->size_left + stk->size_right);
+
+    size_t data_bytes = ((size_t) new_capacity)*sizeof(Elem_t);
+
+    void *p_new_origin = calloc( stack_data_block_size_(data_bytes, sizeof(Elem_t)), 1 );
+    if (!p_new_origin) return STACK_ERROR_MEM_BAD_REALLOC;
+
+    Elem_t *new_data = (Elem_t *) stack_place_data_( p_new_origin, data_bytes, sizeof(Elem_t)
+#ifdef STACK_USE_PROTECTION_CANARY
+                                                     , &stk->p_data_canary_left, &stk->p_data_canary_right
+#endif
+                                                   );
+
+    if (stk->size_left > 0)
+    {
+        memcpy(new_data, stk->data, ((size_t) stk->size_left)*sizeof(Elem_t));
+    }
+    if (stk->size_right > 0)
+    {
+        memcpy( new_data + new_capacity - stk->size_right,
+                stk->data + stk->capacity - stk->size_right,
+                ((size_t) stk->size_right)*sizeof(Elem_t) );
+    }
+
+    if (stk->p_origin) free(stk->p_origin);
+
+    stk->data = new_data;
+    stk->p_origin = p_new_origin;
+    stk->capacity = new_capacity;
+
+#ifdef STACK_USE_POISON
+    for (stacksize_t ind = stk->size_left; ind < stk->capacity - stk->size_right; ind++)
+    {
+        fill_elem_with_poison_(stk->data + ind);
+    }
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode double_stack_realloc(DoubleStack *stk)
+{
+    DOUBLE_STACK_CHECK(stk)
+
+    const int MEM_MULTIPLIER = 2;
+
+    stacksize_t size_total = stk->size_left + stk->size_right;
+    if ( size_total >= stk->capacity )
+    {
+        stacksize_t new_capacity = (stk->capacity == 0) ? MEM_MULTIPLIER : MEM_MULTIPLIER * stk->capacity;
+        return double_stack_realloc_to_(stk, new_capacity);
+    }
+    else if ( size_total > 0 && size_total * ( MEM_MULTIPLIER * MEM_MULTIPLIER ) <= stk->capacity )
+    {
+        return double_stack_realloc_to_(stk, stk->capacity / MEM_MULTIPLIER);
+    }
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+inline void double_stack_dump_data_( DoubleStack *stk )
+{
+    fprintf(stderr, "\t{\n");
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_left,
+                                                                        *(stk->p_data_canary_left));
+#endif
+
+    stacksize_t right_top = stk->capacity - stk->size_right;
+    for (stacksize_t ind = 0; ind < stk->capacity; ind++)
+    {
+        fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "][%p]\t = <", ind, (void *)(stk->data + ind));
+        print_elem_t(stderr, stk->data[ind]);
+        fprintf(stderr, ">");
+
+#ifdef STACK_USE_POISON
+        if (stk->size_left <= ind && ind < right_top)
+        {
+            fprintf(stderr, " (MAYBE POISON)");
+        }
+#endif
+
+        if (ind == stk->size_left) fprintf(stderr, " <-- left");
+        if (ind == right_top - 1)  fprintf(stderr, " <-- right");
+
+        fprintf(stderr, "\n");
+    }
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_right,
+                                                                         *(stk->p_data_canary_right));
+#endif
+
+    fprintf(stderr, "\t}\n");
+}
+
+void double_stack_dump_(DoubleStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "DoubleStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "DoubleStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize_left = <" STACKSIZE_T_SPECF ">\n"
+                    "\tsize_right = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcapacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\tdata[%p]\n", stk->size_left, stk->size_right, stk->capacity, (void *) stk->data);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+                    "\thash_data = <" STACKHASH_T_SPECF ">\n", stk->hash_struct, stk->hash_data);
+#endif
+    if ( !(stk->data) )
+    {
+        fprintf(stderr, "Data pointer is NULL. Data cannot be accessed.\n");
+        return;
+    }
+
+    double_stack_dump_data_(stk);
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // DOUBLE_STACK_H
@@ -0,0 +1,374 @@
+#ifndef FIXED_STACK_H
+#define FIXED_STACK_H
+
+#include "stack.h"
+
+/*
+    Stack of fixed capacity, which is known at compile time. Its storage lives inside
+    the object itself, so it can be placed on the call stack or in static memory and never
+    calls malloc(). Push to a full stack returns STACK_ERROR_OVERFLOW instead of growing.
+
+    All defines from stack.h (STACK_DO_DUMP, STACK_USE_POISON, STACK_USE_PROTECTION_CANARY,
+    STACK_USE_PROTECTION_HASH, etc.) are respected. Note that with STACK_USE_PROTECTION_HASH
+    every push() and pop() rehashes the whole embedded array, so turn it off in hot loops.
+
+    USAGE:
+    FixedStack<64> stk = {};
+    fixed_stack_ctor(&stk);
+    fixed_stack_push(&stk, value);
+*/
+
+template <stacksize_t CAPACITY>
+struct FixedStack
+{
+    static_assert(CAPACITY > 0, "Capacity of FixedStack must be positive");
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    stacksize_t size = -1;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_right = 0;
+
+    canary_t data_canary_left = 0;
+#endif
+
+    Elem_t data[CAPACITY];
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t data_canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks fixed stack's condition.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+template <stacksize_t CAPACITY>
+static int fixed_stack_verify(FixedStack<CAPACITY> *stk);
+
+//! @brief Fixed stack constructor. ONLY FOR INTERNAL USE! USE MACRO fixed_stack_ctor()!
+//! @details Sets size to 0 and places canaries, no memory is allocated.
+//! @param [in] stk Pointer to stack to construct.
+//! @return StackErrorCode enum value.
+template <stacksize_t CAPACITY>
+static StackErrorCode fixed_stack_ctor_( FixedStack<CAPACITY> *stk
+#ifdef STACK_DO_DUMP
+                                         ,
+                                         const char *stack_name,
+                                         const char *orig_file_name,
+                                         const int orig_line,
+                                         const char *orig_func_name
+#endif
+                                       );
+
+//! @brief Fixed stack deconstructor.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+template <stacksize_t CAPACITY>
+static StackErrorCode fixed_stack_dtor(FixedStack<CAPACITY> *stk);
+
+//! @brief Pushes element to fixed stack.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push to the stack.
+//! @return StackErrorCode enum value, STACK_ERROR_OVERFLOW if the stack is full.
+template <stacksize_t CAPACITY>
+static StackErrorCode fixed_stack_push(FixedStack<CAPACITY> *stk, Elem_t value);
+
+//! @brief Pops element from fixed stack.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value.
+template <stacksize_t CAPACITY>
+static StackErrorCode fixed_stack_pop(FixedStack<CAPACITY> *stk, Elem_t *ret_value);
+
+#ifndef STACK_DO_DUMP
+
+#define FIXED_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define FIXED_STACK_DUMP(stk, verify_res) fixed_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+template <stacksize_t CAPACITY>
+static void fixed_stack_dump_(FixedStack<CAPACITY> *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//-----------------------------------FIXED_STACK.CPP------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define FIXED_STACK_CHECK(stk)    {                 \
+    int verify_res = fixed_stack_verify(stk);       \
+    if ( verify_res != 0 ) {                        \
+        FIXED_STACK_DUMP(stk, verify_res);          \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+#ifdef STACK_USE_PROTECTION_HASH
+//! @brief Returns the number of bytes in the beginning of the struct, which are covered
+//! by hash_struct. Embedded data and data canaries are covered by hash_data.
+template <stacksize_t CAPACITY>
+inline unsigned int fixed_stack_struct_len_(const FixedStack<CAPACITY> *stk)
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    return (unsigned int) ((const char *) &stk->data_canary_left - (const char *) stk);
+#else
+    return (unsigned int) ((const char *) stk->data - (const char *) stk);
+#endif
+}
+
+template <stacksize_t CAPACITY>
+inline stackhash_t fixed_stack_compute_hash_struct_(FixedStack<CAPACITY> *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, fixed_stack_struct_len_(stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+template <stacksize_t CAPACITY>
+inline stackhash_t fixed_stack_compute_hash_data_(FixedStack<CAPACITY> *stk)
+{
+    assert(stk);
+
+    return stack_compute_hash( (char *) stk->data, (unsigned int) (CAPACITY*sizeof(Elem_t)) );
+}
+
+template <stacksize_t CAPACITY>
+inline void fixed_stack_update_hash_(FixedStack<CAPACITY> *stk)
+{
+    assert(stk);
+
+    stk->hash_data = fixed_stack_compute_hash_data_(stk);
+    stk->hash_struct = fixed_stack_compute_hash_struct_(stk);
+}
+#endif
+
+template <stacksize_t CAPACITY>
+int fixed_stack_verify(FixedStack<CAPACITY> *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( stk->size < 0 || stk->size > CAPACITY )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( stk->data_canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->data_canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != fixed_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->hash_data != fixed_stack_compute_hash_data_(stk) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define fixed_stack_ctor(stk) fixed_stack_ctor_(stk, #stk, __FILE__, __LINE__, __func__)
+#else
+#define fixed_stack_ctor(stk) fixed_stack_ctor_(stk)
+#endif
+
+template <stacksize_t CAPACITY>
+StackErrorCode fixed_stack_ctor_( FixedStack<CAPACITY> *stk
+#ifdef STACK_DO_DUMP
+                                  ,
+                                  const char *stack_name,
+                                  const char *orig_file_name,
+                                  const int orig_line,
+                                  const char *orig_func_name
+#endif
+                                )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    stk->size = 0;
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+    stk->data_canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->data_canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_POISON
+    for (stacksize_t ind = 0; ind < CAPACITY; ind++)
+    {
+        fill_elem_with_poison_(stk->data + ind);
+    }
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    fixed_stack_update_hash_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+template <stacksize_t CAPACITY>
+StackErrorCode fixed_stack_dtor(FixedStack<CAPACITY> *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    stk->size = -1;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+    stk->data_canary_left = 0;
+    stk->data_canary_right = 0;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stk->hash_data = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+template <stacksize_t CAPACITY>
+StackErrorCode fixed_stack_push(FixedStack<CAPACITY> *stk, Elem_t value)
+{
+    FIXED_STACK_CHECK(stk)
+
+    if ( stk->size >= CAPACITY ) return STACK_ERROR_OVERFLOW;
+
+    (stk->data)[(stk->size)++] = value;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    fixed_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+template <stacksize_t CAPACITY>
+StackErrorCode fixed_stack_pop(FixedStack<CAPACITY> *stk, Elem_t *ret_value)
+{
+    FIXED_STACK_CHECK(stk)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    if (stk->size == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        FIXED_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+    *ret_value = stk->data[--(stk->size)];
+
+#ifdef STACK_USE_POISON
+    fill_elem_with_poison_(stk->data + stk->size);
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    fixed_stack_update_hash_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+template <stacksize_t CAPACITY>
+void fixed_stack_dump_(FixedStack<CAPACITY> *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "FixedStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "FixedStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcapacity = <" STACKSIZE_T_SPECF "> (fixed)\n"
+                    "\tdata[%p]\n", stk->size, CAPACITY, (void *) stk->data);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+                    "\thash_data = <" STACKHASH_T_SPECF ">\n", stk->hash_struct, stk->hash_data);
+#endif
+
+    fprintf(stderr, "\t{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) &stk->data_canary_left,
+                                                                        stk->data_canary_left);
+#endif
+
+    stack_dump_elems_(stderr, stk->data, stk->size, CAPACITY, 0, CAPACITY, 0);
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) &stk->data_canary_right,
+                                                                         stk->data_canary_right);
+#endif
+    fprintf(stderr, "\t}\n");
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // FIXED_STACK_H
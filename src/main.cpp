@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 struct fortest
 {
@@ -17,9 +18,20 @@ void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "{i = %d, d
 #define STACK_DUMP_ON_INVALID_POP
 #define STACK_USE_PROTECTION_CANARY
 #define STACK_USE_PROTECTION_HASH
+#define STACK_USE_HASH_TREE
 //#define STACK_FULL_DEBUG_INFO
+#define STACK_USE_ADAPTIVE_CAPACITY
 
 #include "stack.h"
+#include "fixed_stack.h"
+#include "persistent_stack.h"
+#include "double_stack.h"
+#include "byte_stack.h"
+#include "bit_stack.h"
+#include "compact_int_stack.h"
+#include "tiered_stack.h"
+#include "blocking_stack.h"
+#include "stack_array.h"
 
 int main()
 {
@@ -73,8 +85,204 @@ int main()
     printf("\n");
     STACK_DUMP(&stk, 0);
 
+    printf("----dump with options\n");
+    StackDumpOptions dump_opts = {};
+    dump_opts.stream = stdout;
+    dump_opts.window = 2;
+    dump_opts.collapse_runs = 1;
+    STACK_DUMP_EX(&stk, 0, &dump_opts);
+
+    FILE *raw_dump = tmpfile();
+    if (raw_dump)
+    {
+        printf("raw dump: %d\n", stack_dump_raw(&stk, raw_dump));
+        fclose(raw_dump);
+    }
+
     stack_dtor(&stk);
 
+    printf("----hash tree\n");
+    // one damaged element is found by the hash tree within its block
+    Stack htstk = {};
+    stack_ctor(&htstk);
+    for (int i = 0; i < 3*STACK_HASH_BLOCK_ELEMS; i++) stack_push(&htstk, {i, 0, 'h'});
+    htstk.data[STACK_HASH_BLOCK_ELEMS + 1].i = -1;
+    int ht_verify_res = stack_verify(&htstk);
+    char ht_range[64] = "";
+    snprintf(ht_range, sizeof(ht_range), "data[%d..%d)", STACK_HASH_BLOCK_ELEMS, 2*STACK_HASH_BLOCK_ELEMS);
+    int is_range_dumped = 0;
+    FILE *ht_dump = tmpfile();
+    if (ht_dump)
+    {
+        StackDumpOptions ht_opts = {};
+        ht_opts.stream = ht_dump;
+        ht_opts.window = 0;
+        STACK_DUMP_EX(&htstk, ht_verify_res, &ht_opts);
+        rewind(ht_dump);
+        char ht_line[256] = "";
+        while ( fgets(ht_line, sizeof(ht_line), ht_dump) )
+        {
+            if ( strstr(ht_line, ht_range) ) is_range_dumped = 1;
+        }
+        fclose(ht_dump);
+    }
+    htstk.data[STACK_HASH_BLOCK_ELEMS + 1].i = STACK_HASH_BLOCK_ELEMS + 1;
+    stack_dtor(&htstk);
+    printf("verify %d, damaged %s %s\n", ht_verify_res, ht_range, (is_range_dumped) ? "dumped" : "not dumped");
+    if ( !(ht_verify_res & STACK_VERIFY_DATA_HASH_INVALID) || !is_range_dumped ) return 1;
+
+    printf("----fixed stack\n");
+    FixedStack<4> fstk = {};
+    fixed_stack_ctor(&fstk);
+    for (int i = 0; fixed_stack_push(&fstk, {i, i*0.5, 'x'}) != STACK_ERROR_OVERFLOW; i++)
+        ;
+    fixed_stack_pop(&fstk, &x);
+    print_elem_t(stdout, x);
+    printf("\n");
+    FIXED_STACK_DUMP(&fstk, 0);
+    fixed_stack_dtor(&fstk);
+
+    printf("----persistent stack\n");
+    PersistentStack pstk = {}, pstk_saved = {};
+    persistent_stack_ctor(&pstk);
+    persistent_stack_ctor(&pstk_saved);
+    persistent_stack_push(&pstk, {1, 1.1, 'a'});
+    persistent_stack_snapshot(&pstk_saved, &pstk);
+    persistent_stack_push(&pstk, {2, 2.2, 'b'});
+    persistent_stack_rollback(&pstk, &pstk_saved);
+    persistent_stack_pop(&pstk, &x);
+    print_elem_t(stdout, x);
+    printf("\n");
+    persistent_stack_dtor(&pstk_saved);
+    persistent_stack_dtor(&pstk);
+
+    printf("----double stack\n");
+    DoubleStack dstk = {};
+    double_stack_ctor(&dstk);
+    double_stack_push(&dstk, DOUBLE_STACK_LEFT,  {3, 3.3, 'l'});
+    double_stack_push(&dstk, DOUBLE_STACK_RIGHT, {4, 4.4, 'r'});
+    double_stack_pop(&dstk, DOUBLE_STACK_RIGHT, &x);
+    print_elem_t(stdout, x);
+    printf("\n");
+    DOUBLE_STACK_DUMP(&dstk, 0);
+    double_stack_dtor(&dstk);
+
+    printf("----byte stack\n");
+    ByteStack bstk = {};
+    byte_stack_ctor(&bstk);
+    byte_stack_push(&bstk, "short", 5);
+    byte_stack_push(&bstk, "a bit longer record", 19);
+    const void *top = NULL;
+    stacksize_t top_len = 0;
+    byte_stack_peek(&bstk, &top, &top_len);
+    printf("%.*s\n", (int) top_len, (const char *) top);
+    char top_buf[32] = "";
+    byte_stack_pop(&bstk, top_buf, sizeof(top_buf), &top_len);
+    byte_stack_push(&bstk, top_buf, top_len);
+    BYTE_STACK_DUMP(&bstk, 0);
+    byte_stack_dtor(&bstk);
+
+    printf("----bit stack\n");
+    BitStack bitstk = {};
+    bit_stack_ctor(&bitstk, 3);
+    bit_stack_push(&bitstk, 5);
+    bit_stack_push_word(&bitstk, 0x7 | (0x2 << 3), 2);
+    unsigned bit_value = 0;
+    bit_stack_pop(&bitstk, &bit_value);
+    printf("%u\n", bit_value);
+    BIT_STACK_DUMP(&bitstk, 0);
+    bit_stack_dtor(&bitstk);
+
+    printf("----compact int stack\n");
+    CompactIntStack cistk = {};
+    compact_int_stack_ctor(&cistk);
+    for (int i = 0; i < 100; i++) compact_int_stack_push(&cistk, 1000 + i % 10);
+    int64_t int_value = 0;
+    compact_int_stack_pop(&cistk, &int_value);
+    printf("%lld, %zu bytes\n", (long long) int_value, compact_int_stack_memory(&cistk));
+    compact_int_stack_dtor(&cistk);
+
+    printf("----tiered stack\n");
+    TieredStack tstk = {};
+    if ( tiered_stack_ctor(&tstk, 2*TIERED_STACK_BLOCK_ELEMS, NULL) == STACK_ERROR_NO_ERROR )
+    {
+        for (int i = 0; i < 4*TIERED_STACK_BLOCK_ELEMS; i++) tiered_stack_push(&tstk, {i, 0, 't'});
+        printf("spilled blocks: %ld\n", tstk.spilled_blocks);
+        while (tiered_stack_pop(&tstk, &x) == STACK_ERROR_NO_ERROR)
+            ;
+        print_elem_t(stdout, x);
+        printf("\n");
+        tiered_stack_dtor(&tstk);
+    }
+
+    printf("----blocking stack\n");
+    BlockingStack blstk = {};
+    blocking_stack_ctor(&blstk, 4);
+    for (int i = 0; i < 4; i++) blocking_stack_push(&blstk, {i, 0, 'b'});
+    printf("push to full: %d\n", blocking_stack_push_timed(&blstk, {4, 0, 'b'}, 10));
+    Elem_t batch[3] = {};
+    stacksize_t batch_count = 0;
+    blocking_stack_pop_batch(&blstk, batch, 3, &batch_count, -1);
+    printf("batch of " STACKSIZE_T_SPECF ", top was %d\n", batch_count, batch[0].i);
+    blocking_stack_close(&blstk);
+    printf("push after close: %d\n", blocking_stack_push(&blstk, {5, 0, 'b'}));
+    blocking_stack_pop(&blstk, &x);
+    printf("pop after close: %d, then %d\n", x.i, blocking_stack_pop_timed(&blstk, &x, 0));
+    blocking_stack_dtor(&blstk);
+
+    printf("----stack array\n");
+    StackArray sarr = {};
+    stack_array_ctor(&sarr, 0);
+    stacksize_t sarr_ids[3] = {};
+    stack_array_create(&sarr, 3, 2, sarr_ids);
+    for (int i = 0; i < 5; i++) stack_array_push(&sarr, sarr_ids[i % 3], {i, 0, 'a'});
+    stack_array_destroy(&sarr, 1, sarr_ids + 2);
+    stack_array_pop(&sarr, sarr_ids[0], &x);
+    stack_array_compact(&sarr, 0);
+    const Elem_t *sarr_data = NULL;
+    stacksize_t sarr_size = 0;
+    stack_array_view(&sarr, sarr_ids[1], &sarr_data, &sarr_size);
+    printf("popped %d, stack 1 has " STACKSIZE_T_SPECF " elements, %zu bytes\n", x.i, sarr_size, stack_array_memory(&sarr));
+
+    // a stack of zero capacity stays usable after the stack below it at the end of the arena is destroyed
+    stacksize_t sarr_tail = 0, sarr_empty = 0;
+    stack_array_create(&sarr, 1, 4, &sarr_tail);
+    stack_array_create(&sarr, 1, 0, &sarr_empty);
+    stack_array_destroy(&sarr, 1, &sarr_tail);
+    StackErrorCode sarr_push_res = stack_array_push(&sarr, sarr_empty, {7, 0, 'z'});
+    StackErrorCode sarr_destroy_res = stack_array_destroy(&sarr, 1, &sarr_empty);
+    printf("zero capacity stack: push %d, destroy %d\n", sarr_push_res, sarr_destroy_res);
+    stack_array_dtor(&sarr);
+    if ( sarr_push_res || sarr_destroy_res ) return 1;
+
+    printf("----adaptive capacity\n");
+    // stacks from one place reach 5 elements, so the later ones get capacity 8 at the first push
+    StackCallsite *adaptive_site = NULL;
+    stacksize_t adaptive_capacity = 0;
+    for (int i = 0; i < 2*STACK_ADAPTIVE_MIN_SAMPLES; i++)
+    {
+        Stack adstk = {};
+        stack_ctor(&adstk);
+        stack_push(&adstk, {0, 0, 'a'});
+        adaptive_capacity = adstk.capacity;
+        for (int j = 1; j < 5; j++) stack_push(&adstk, {j, 0, 'a'});
+        adaptive_site = adstk.callsite;
+        stack_dtor(&adstk);
+    }
+    printf("learned capacity " STACKSIZE_T_SPECF "\n", adaptive_capacity);
+    if ( !adaptive_site || adaptive_capacity != 8 ) return 1;
+
+    // the exported table is imported back, which doubles the counters of the place
+    unsigned long long adaptive_peaks = adaptive_site->peaks[stack_adaptive_bucket_(5)];
+    FILE *adaptive_file = tmpfile();
+    StackErrorCode export_res = stack_adaptive_export(adaptive_file);
+    if (adaptive_file) rewind(adaptive_file);
+    StackErrorCode import_res = stack_adaptive_import(adaptive_file);
+    if (adaptive_file) fclose(adaptive_file);
+    printf("export %d, import %d, peaks %llu -> %llu\n", export_res, import_res, adaptive_peaks,
+           adaptive_site->peaks[stack_adaptive_bucket_(5)]);
+    if ( export_res || import_res || adaptive_site->peaks[stack_adaptive_bucket_(5)] != 2*adaptive_peaks ) return 1;
+
     printf("The END!\n");
 
     return 0;
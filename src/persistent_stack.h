@@ -0,0 +1,414 @@
+#ifndef PERSISTENT_STACK_H
+#define PERSISTENT_STACK_H
+
+#include "stack.h"
+
+/*
+    Persistent stack: every version of the stack is a pointer to an immutable node, nodes
+    are shared between versions and freed by reference counting. Snapshot, push onto a
+    snapshot and rollback to a snapshot are all O(1), unchanged prefixes are never copied.
+    Reference counts are not atomic, so versions must not be shared between threads.
+
+    USAGE:
+    PersistentStack stk = {}, saved = {};
+    persistent_stack_ctor(&stk);
+    persistent_stack_ctor(&saved);
+    persistent_stack_push(&stk, value);
+    persistent_stack_snapshot(&saved, &stk);    // remember branch point
+    persistent_stack_push(&stk, other_value);   // saved doesn't see it
+    persistent_stack_rollback(&stk, &saved);    // back to the branch point
+*/
+
+struct PersistentStackNode
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left;
+#endif
+
+    long refs;
+    PersistentStackNode *next;
+    Elem_t value;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_value;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_right;
+#endif
+};
+
+struct PersistentStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    PersistentStackNode *top = NULL;
+    stacksize_t size = -1;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks persistent stack's condition. Only the top node is checked, so it is O(1).
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int persistent_stack_verify(PersistentStack *stk);
+
+//! @brief Persistent stack constructor. ONLY FOR INTERNAL USE! USE MACRO persistent_stack_ctor()!
+//! @param [in] stk Pointer to stack to construct.
+//! @return StackErrorCode enum value.
+StackErrorCode persistent_stack_ctor_( PersistentStack *stk
+#ifdef STACK_DO_DUMP
+                                       ,
+                                       const char *stack_name,
+                                       const char *orig_file_name,
+                                       const int orig_line,
+                                       const char *orig_func_name
+#endif
+                                     );
+
+//! @brief Persistent stack deconstructor. Frees nodes which are not used by other versions.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode persistent_stack_dtor(PersistentStack *stk);
+
+//! @brief Pushes element to persistent stack. Other versions sharing the old top are not affected.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push to the stack.
+//! @return StackErrorCode enum value.
+static StackErrorCode persistent_stack_push(PersistentStack *stk, Elem_t value);
+
+//! @brief Pops element from persistent stack. Other versions sharing the old top are not affected.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value.
+static StackErrorCode persistent_stack_pop(PersistentStack *stk, Elem_t *ret_value);
+
+//! @brief Makes dst a snapshot of src in O(1). Previous version held by dst is released.
+//! @param [in] dst Pointer to constructed stack, which becomes the snapshot.
+//! @param [in] src Pointer to the stack to take snapshot of.
+//! @return StackErrorCode enum value.
+static StackErrorCode persistent_stack_snapshot(PersistentStack *dst, PersistentStack *src);
+
+//! @brief Returns stk to the version held by snapshot in O(1).
+//! @param [in] stk Pointer to the stack.
+//! @param [in] snapshot Pointer to the snapshot made by persistent_stack_snapshot().
+//! @return StackErrorCode enum value.
+static StackErrorCode persistent_stack_rollback(PersistentStack *stk, PersistentStack *snapshot);
+
+#ifndef STACK_DO_DUMP
+
+#define PERSISTENT_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define PERSISTENT_STACK_DUMP(stk, verify_res) persistent_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void persistent_stack_dump_(PersistentStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------PERSISTENT_STACK.CPP----------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define PERSISTENT_STACK_CHECK(stk)    {            \
+    int verify_res = persistent_stack_verify(stk);  \
+    if ( verify_res != 0 ) {                        \
+        PERSISTENT_STACK_DUMP(stk, verify_res);     \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t persistent_stack_compute_hash_struct_(PersistentStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+inline stackhash_t persistent_stack_compute_hash_node_(PersistentStackNode *node)
+{
+    assert(node);
+
+    return stack_compute_hash( (char *) &node->value, sizeof(node->value) );
+}
+#endif
+
+int persistent_stack_verify(PersistentStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( (stk->top == NULL) != (stk->size == 0) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( stk->size < 0 )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( stk->top && ( stk->top->canary_left != CANARY_LEFT_DEFAULT_VALUE
+                    || stk->top->canary_right != CANARY_RIGHT_DEFAULT_VALUE ) )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != persistent_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->top && stk->top->hash_value != persistent_stack_compute_hash_node_(stk->top) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//! @brief Drops one reference to node, freeing it and all the nodes below which become unused.
+inline void persistent_stack_release_(PersistentStackNode *node)
+{
+    while ( node && --(node->refs) == 0 )
+    {
+        PersistentStackNode *next = node->next;
+#ifdef STACK_USE_POISON
+        fill_elem_with_poison_(&node->value);
+#endif
+        free(node);
+        node = next;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define persistent_stack_ctor(stk) persistent_stack_ctor_(stk, #stk, __FILE__, __LINE__, __func__)
+#else
+#define persistent_stack_ctor(stk) persistent_stack_ctor_(stk)
+#endif
+
+StackErrorCode persistent_stack_ctor_( PersistentStack *stk
+#ifdef STACK_DO_DUMP
+                                       ,
+                                       const char *stack_name,
+                                       const char *orig_file_name,
+                                       const int orig_line,
+                                       const char *orig_func_name
+#endif
+                                     )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    persistent_stack_dtor(stk);
+
+    stk->top = NULL;
+    stk->size = 0;
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = persistent_stack_compute_hash_struct_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode persistent_stack_dtor(PersistentStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    persistent_stack_release_(stk->top);
+    stk->top = NULL;
+    stk->size = -1;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode persistent_stack_push(PersistentStack *stk, Elem_t value)
+{
+    PERSISTENT_STACK_CHECK(stk)
+
+    PersistentStackNode *node = (PersistentStackNode *) calloc(1, sizeof(PersistentStackNode));
+    if (!node) return STACK_ERROR_MEM_BAD_REALLOC;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    node->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    node->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+    node->refs = 1;
+    node->next = stk->top; // reference of stk to the old top is passed to the new node
+    node->value = value;
+#ifdef STACK_USE_PROTECTION_HASH
+    node->hash_value = persistent_stack_compute_hash_node_(node);
+#endif
+
+    stk->top = node;
+    stk->size++;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = persistent_stack_compute_hash_struct_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode persistent_stack_pop(PersistentStack *stk, Elem_t *ret_value)
+{
+    PERSISTENT_STACK_CHECK(stk)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    if (stk->size == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        PERSISTENT_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    PersistentStackNode *old_top = stk->top;
+    *ret_value = old_top->value;
+
+    stk->top = old_top->next;
+    if (stk->top) stk->top->refs++;
+    stk->size--;
+    persistent_stack_release_(old_top);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = persistent_stack_compute_hash_struct_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode persistent_stack_snapshot(PersistentStack *dst, PersistentStack *src)
+{
+    PERSISTENT_STACK_CHECK(src)
+    PERSISTENT_STACK_CHECK(dst)
+
+    if (dst == src) return STACK_ERROR_NO_ERROR;
+
+    if (src->top) src->top->refs++;
+    persistent_stack_release_(dst->top);
+
+    dst->top = src->top;
+    dst->size = src->size;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    dst->hash_struct = persistent_stack_compute_hash_struct_(dst);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode persistent_stack_rollback(PersistentStack *stk, PersistentStack *snapshot)
+{
+    return persistent_stack_snapshot(stk, snapshot);
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+void persistent_stack_dump_(PersistentStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "PersistentStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "PersistentStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\ttop[%p]\n", stk->size, (void *) stk->top);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n", stk->hash_struct);
+#endif
+
+    fprintf(stderr, "\t{\n");
+    stacksize_t ind = stk->size - 1;
+    for (PersistentStackNode *node = stk->top; node && ind >= 0; node = node->next, ind--)
+    {
+        fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "][%p] refs = <%ld>\t = <", ind, (void *) node, node->refs);
+        print_elem_t(stderr, node->value);
+        fprintf(stderr, ">");
+#ifdef STACK_USE_PROTECTION_CANARY
+        if ( node->canary_left != CANARY_LEFT_DEFAULT_VALUE || node->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+            fprintf(stderr, " (CANARY DAMAGED: <" CANARY_T_SPECF "> <" CANARY_T_SPECF ">)", node->canary_left,
+                                                                                          node->canary_right);
+#endif
+#ifdef STACK_USE_PROTECTION_HASH
+        if ( node->hash_value != persistent_stack_compute_hash_node_(node) )
+            fprintf(stderr, " (HASH INVALID)");
+#endif
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "\t}\n");
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // PERSISTENT_STACK_H
@@ -7,6 +7,21 @@
 #include <stdio.h>
 #include <time.h>
 
+#ifdef STACK_USE_VIRTUAL_MEMORY
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef STACK_USE_HASH_TREE
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef STACK_DO_DUMP
+#include <unistd.h>
+#include "stack_dump_format.h"
+#endif
+
 /*
     REMEMBER TO DO FOLLOWING LINES BEFORE #include "stack.h" IN YOUR FILE:
     typedef *your_type* Elem_t
@@ -16,6 +31,12 @@
     typedef int Elem_t
     void inline print_elem_t(FILE *stream, Elem_t val) { fprintf(stream, "%d", val); }
 
+    IF STACK_USE_AGGREGATE IS DEFINED, ALSO DO:
+    Elem_t inline aggregate_elem_t(Elem_t accum, Elem_t val) { *your code here* }
+
+    FOR EXAMPLE (MINIMUM):
+    Elem_t inline aggregate_elem_t(Elem_t accum, Elem_t val) { return (val < accum) ? val : accum; }
+
 */
 
 
@@ -28,6 +49,11 @@
 #define STACK_USE_PROTECTION_CANARY
 #define STACK_USE_PROTECTION_HASH
 #define STACK_FULL_DEBUG_INFO
+#define STACK_USE_VIRTUAL_MEMORY
+#define STACK_USE_AGGREGATE
+#define STACK_USE_HASH_TREE
+#define STACK_USE_ADAPTIVE_CAPACITY
+#define STACK_DUMP_WINDOW <number>
 */
 
 //--------------------------------------------------------------------------------------------
@@ -48,12 +74,55 @@ const canary_t CANARY_LEFT_DEFAULT_VALUE  = 0xDEDEDED;
 const canary_t CANARY_RIGHT_DEFAULT_VALUE = 0xDEDEDED;
 #endif
 
+#if defined(STACK_USE_AGGREGATE) && defined(STACK_USE_VIRTUAL_MEMORY)
+#error "STACK_USE_AGGREGATE can't be used together with STACK_USE_VIRTUAL_MEMORY"
+#endif
+
+#ifdef STACK_USE_AGGREGATE
+//! @brief Number of arrays of capacity elements in the data block: data and aggr.
+const size_t STACK_DATA_ARRAYS_NUM = 2;
+#else
+const size_t STACK_DATA_ARRAYS_NUM = 1;
+#endif
+
+#ifdef STACK_USE_VIRTUAL_MEMORY
+#ifndef STACK_VM_RESERVE_SIZE
+//! @brief Size of address space reserved by every stack, it limits the stack's capacity.
+#define STACK_VM_RESERVE_SIZE ( (size_t) 1 << 36 )
+#endif
+const size_t STACK_VM_HUGE_PAGE_SIZE = (size_t) 2 << 20;
+#endif
+
+#ifdef STACK_DO_DUMP
+//! @brief Size of the buffer used while printing a dump.
+const size_t STACK_DUMP_BUFFER_SIZE = (size_t) 1 << 16;
+#endif
+
+#if defined(STACK_DO_DUMP) || defined(STACK_USE_ADAPTIVE_CAPACITY)
+//! @brief Stack remembers where it was constructed: for dumps and for adaptive capacity.
+#define STACK_KEEP_ORIGIN_
+#endif
+
 #ifdef STACK_USE_PROTECTION_HASH
 typedef long long stackhash_t;
 const stackhash_t HASH_DEFAULT_VALUE = 0;
 #define STACKHASH_T_SPECF "%llX"
 #endif
 
+#if defined(STACK_USE_HASH_TREE) && !defined(STACK_USE_PROTECTION_HASH)
+#error "STACK_USE_HASH_TREE requires STACK_USE_PROTECTION_HASH"
+#endif
+
+#ifdef STACK_USE_HASH_TREE
+#ifndef STACK_HASH_BLOCK_ELEMS
+//! @brief Number of elements covered by one leaf of the hash tree. Push and pop rehash a couple of blocks.
+#define STACK_HASH_BLOCK_ELEMS 64
+#endif
+//! @brief stack_verify() checks blocks on a pool of threads only if there are at least this many of them.
+const long STACK_HASH_PARALLEL_MIN_BLOCKS = 1024;
+const long STACK_HASH_MAX_THREADS = 16;
+#endif
+
 /*
     ------------------------------------TODO--------------------------------------
 
@@ -70,6 +139,11 @@ enum StackErrorCode
     STACK_ERROR_NULL_RET_VALUE_PNT  = 3, //< NULL passed as a pointer to the return value.
     STACK_ERROR_MEM_BAD_REALLOC     = 4, //< Stack reallocation failed.
     STACK_ERROR_NOTHING_TO_POP      = 5, //< Stack is empty, but pop() was called.
+    STACK_ERROR_OVERFLOW            = 6, //< Stack of fixed capacity is full, but push() was called.
+    STACK_ERROR_IO                  = 7, //< Reading or writing a file failed.
+    STACK_ERROR_BAD_ARG             = 8, //< Argument is out of its allowed range.
+    STACK_ERROR_TIMEOUT             = 9, //< Blocking operation has not finished in time.
+    STACK_ERROR_CLOSED              = 10, //< Stack is closed, nothing can be pushed to it.
 };
 
 //! @brief Mask consisting of values of this enum is returned by stack_verify().
@@ -99,15 +173,10 @@ const char *verification_messages[] =
       "2: Pointer to data is NULL and either size != 0 or capacity != 0.",
       "4: Size < 0 or size > capacity.",
       "8: Capacity < 0.",
-#ifdef STACK_USE_PROTECTION_CANARY
      "16: One or both canaries in struct are damaged.",
      "32: One or both canaries in data are damaged.",
-#endif
-#ifdef STACK_USE_PROTECTION_HASH
-     "64: Stack's struct hash is invalid."
-    "128: Stack's data hash is invalid."
-#endif
-
+     "64: Stack's struct hash is invalid.",
+    "128: Stack's data hash is invalid.",
 };
 
 //! @brief Gets verification result and prints corresponding error message for every error.
@@ -118,11 +187,15 @@ inline void print_verify_res(FILE *stream, int verify_res)
     {
         if (verify_res & ( 1 << ind ))
         {
-            printf("----> %s\n", verification_messages[ind]);
+            fprintf(stream, "----> %s\n", verification_messages[ind]);
         }
     }
 }
 
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+#include "stack_adaptive.h"
+#endif
+
 struct Stack
 {
 #ifdef STACK_USE_PROTECTION_CANARY
@@ -130,6 +203,9 @@ struct Stack
 #endif
 
     Elem_t *data = NULL;
+#ifdef STACK_USE_AGGREGATE
+    Elem_t *aggr = NULL; // aggr[i] - свертка data[0..i] с помощью aggregate_elem_t(), лежит сразу после data
+#endif
     stacksize_t size = -1;
     stacksize_t capacity = -1;
 
@@ -137,14 +213,27 @@ struct Stack
     stackhash_t hash_struct = HASH_DEFAULT_VALUE;
     stackhash_t hash_data = HASH_DEFAULT_VALUE;
 #endif
+#ifdef STACK_USE_HASH_TREE
+    stackhash_t *hash_tree = NULL; // дерево хешей блоков data, hash_tree[1] - корень, листья начиная с hash_tree_leaves
+    stacksize_t hash_tree_leaves = 0;
+    stacksize_t hash_tree_capacity = -1; // capacity, для которой построено дерево
+#endif
 
-#ifdef STACK_DO_DUMP
+#ifdef STACK_KEEP_ORIGIN_
     const char *stack_name = NULL;
     const char *orig_file_name = NULL;
     int orig_line = -1;
     const char *orig_func_name = NULL;
+#endif
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+    StackCallsite *callsite = NULL; // запись о месте вызова конструктора, NULL если его нет в таблице
+    stacksize_t peak_size = -1; // наибольший размер стека за все время
+    stacksize_t min_capacity = -1; // емкость, выученная для этого места; ниже нее стек не сжимается
 #endif
     void *p_origin = NULL; // настоящий указатель на начало блока памяти, в котором лежит data
+#ifdef STACK_USE_VIRTUAL_MEMORY
+    size_t vm_committed = 0; // сколько байт от p_origin сейчас доступно для чтения и записи
+#endif
 
 #ifdef STACK_USE_PROTECTION_CANARY
     canary_t* p_data_canary_left = NULL;
@@ -178,24 +267,34 @@ static int stack_is_dmgd_canary_data_(const Stack *stk);
 static stackhash_t stack_compute_hash(char * key, unsigned int len);
 
 //! @brief Check's stack's data hash. Returns 1 if hash is valid, 0 otherwise.
+//! With STACK_USE_HASH_TREE every block is rehashed, for big stacks on a pool of threads.
 static int stack_is_hash_data_valid(Stack *stk);
 
+//! @brief Same as stack_is_hash_data_valid(), but with STACK_USE_HASH_TREE only the blocks of elements
+//! size - 1 and size are rehashed, the rest of the tree is trusted up to the root, which must equal hash_data.
+static int stack_is_hash_top_valid_(Stack *stk);
+
 //! @brief Check's stack's struct hash. Returns 1 if hash is valid, 0 otherwise.
 static int stack_is_hash_struct_valid(Stack *stk);
 
 //! @brief Recomputes stack's hash and writes the new one in the stack.
 static void stack_update_hash(Stack *stk);
+
+//! @brief Updates stack's hash after only element with index ind (and its aggregate) was changed.
+//! With STACK_USE_HASH_TREE only the dirty blocks are rehashed, otherwise it is stack_update_hash().
+static void stack_update_hash_elem_(Stack *stk, stacksize_t ind);
 #endif
 
 //---------------------------------------------------------------------------------------------------
 
 //! @brief Stack constructor. ONLY FOR INTERNAL USE! USE MACRO stack_ctor()!
 //! @details It doesn't allocate memory, setting size and capacity equalling 0. But
-//! first push() will lead to realloc_up().
+//! first push() will lead to realloc_up(). With STACK_USE_ADAPTIVE_CAPACITY realloc_up()
+//! allocates at once the capacity learned for the place of the call, if orig_file_name isn't NULL.
 //! @param [in] stk Pointer to stack to construct.
 //! @return StackErrorCode enum value.
 StackErrorCode stack_ctor_( Stack *stk
-#ifdef STACK_DO_DUMP
+#ifdef STACK_KEEP_ORIGIN_
                             ,
                             const char *stack_name,
                             const char *orig_file_name,
@@ -221,10 +320,24 @@ static StackErrorCode stack_push(Stack *stk, Elem_t value);
 //! @return StackErrorCode enum value.
 static StackErrorCode stack_pop(Stack *stk, Elem_t *ret_value);
 
+#ifdef STACK_USE_AGGREGATE
+//! @brief Returns in O(1) the fold of all elements in the stack by aggregate_elem_t(),
+//! e.g. minimum, maximum or sum, depending on the aggregate_elem_t() you have defined.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put the aggregate to.
+//! @return StackErrorCode enum value, STACK_ERROR_NOTHING_TO_POP if the stack is empty.
+static StackErrorCode stack_aggregate(Stack *stk, Elem_t *ret_value);
+#endif
+
 //! @brief Checks stack's state and, if needed, reallocs memory for the stack and changes stk->data.
 //! @param [in] stk Pointer to the stack.
 //! @return StackErrorCode enum value.
-static StackErrorCode stack_realloc(Stack *stk);
+inline StackErrorCode stack_realloc(Stack *stk);
+
+//! @brief Same as stack_realloc(), but the top isn't checked, for push and pop which have just checked it.
+//! With STACK_USE_HASH_TREE the whole stack is still checked before it is reallocated;
+//! without it the check of the top is already the full one.
+inline StackErrorCode stack_realloc_(Stack *stk);
 
 #ifndef STACK_DO_DUMP
 
@@ -234,8 +347,32 @@ static StackErrorCode stack_realloc(Stack *stk);
 
 #define STACK_DUMP(stk, verify_res) stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
 
+//! @brief Same as STACK_DUMP(), but options are taken from StackDumpOptions *opts.
+#define STACK_DUMP_EX(stk, verify_res, opts) stack_dump_ex_( (stk), verify_res, opts, __FILE__, __LINE__, __func__)
+
+//! @brief Options of STACK_DUMP_EX(). Default ones (= {}) give the same dump as STACK_DUMP().
+struct StackDumpOptions
+{
+    FILE *stream = NULL;        //< Stream to print the dump to. If NULL and fd < 0, stderr is used.
+    int fd = -1;                //< File descriptor to print the dump to, used if stream is NULL.
+    stacksize_t first = 0;      //< Index of the first element to print.
+    stacksize_t last = -1;      //< Index after the last element to print, -1 means capacity.
+    stacksize_t window = -1;    //< If >= 0, only elements [size - window, size + window) are printed.
+    int collapse_runs = 0;      //< If non-zero, runs of identical elements (e.g. poison) take two lines.
+};
+
 static void stack_dump_(Stack *stk, int verify_res, const char *file, int line, const char *func);
 
+static void stack_dump_ex_( Stack *stk, int verify_res, const StackDumpOptions *opts,
+                            const char *file, int line, const char *func );
+
+//! @brief Writes the stack in binary form: StackRawDumpHeader from stack_dump_format.h followed
+//! by the data block. It can be decoded by tools/stack_dump_decode.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] stream Stream opened for binary writing.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if writing failed.
+inline StackErrorCode stack_dump_raw(Stack *stk, FILE *stream);
+
 #endif //STACK_DO_DUMP
 
 //--------------------------------------------------------------------------------------
@@ -252,7 +389,17 @@ static void stack_dump_(Stack *stk, int verify_res, const char *file, int line,
     }                                       \
 }
 
-int stack_verify(Stack *stk)
+//! @brief Same as STACK_CHECK(), but the data hash is checked only around the top, see stack_is_hash_top_valid_().
+#define STACK_CHECK_TOP(stk)    {               \
+    int verify_res = stack_verify_top_(stk);    \
+    if ( verify_res != 0 ) {                    \
+        STACK_DUMP(stk, verify_res);            \
+        return STACK_ERROR_VERIFY;              \
+    }                                           \
+}
+
+//! @brief Checks everything but the data hash.
+inline int stack_verify_struct_(Stack *stk)
 {
     int error = 0;
 
@@ -268,6 +415,11 @@ int stack_verify(Stack *stk)
     if ( stk && stk->capacity < 0)
     error |= STACK_VERIFY_CAPACITY_INVALID;
 
+#ifdef STACK_USE_AGGREGATE
+    if ( stk && stk->data && stk->aggr != stk->data + stk->capacity )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+#endif
+
 #ifdef STACK_USE_PROTECTION_CANARY
     if ( stk && stack_is_dmgd_canary_struct_(stk) )
     error |= STACK_VERIFY_CANARY_STRCUT_DMG;
@@ -279,7 +431,16 @@ int stack_verify(Stack *stk)
 #ifdef STACK_USE_PROTECTION_HASH
     if (stk && stk->data && !stack_is_hash_struct_valid(stk))
     error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+#endif
+
+    return error;
+}
 
+int stack_verify(Stack *stk)
+{
+    int error = stack_verify_struct_(stk);
+
+#ifdef STACK_USE_PROTECTION_HASH
     if (stk && stk->data && !stack_is_hash_data_valid(stk))
     error |= STACK_VERIFY_DATA_HASH_INVALID;
 #endif
@@ -287,6 +448,19 @@ int stack_verify(Stack *stk)
     return error;
 }
 
+//! @brief Same as stack_verify(), but fast enough for every push and pop, see stack_is_hash_top_valid_().
+inline int stack_verify_top_(Stack *stk)
+{
+    int error = stack_verify_struct_(stk);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if (stk && stk->data && !stack_is_hash_top_valid_(stk))
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
 #ifdef STACK_USE_PROTECTION_CANARY
 
 int stack_is_dmgd_canary_struct_(const Stack *stk)
@@ -370,7 +544,7 @@ inline stackhash_t stack_compute_hash_data_(Stack *stk)
 {
     assert(stk);
 
-    return stack_compute_hash( (char *) stk->data, (unsigned int) (stk->capacity)*sizeof(Elem_t));
+    return stack_compute_hash( (char *) stk->data, (unsigned int) ((size_t) stk->capacity*STACK_DATA_ARRAYS_NUM*sizeof(Elem_t)) );
 }
 
 inline stackhash_t stack_compute_hash_struct_(Stack *stk)
@@ -380,14 +554,274 @@ inline stackhash_t stack_compute_hash_struct_(Stack *stk)
     return stack_compute_hash( (char *) stk, sizeof(*stk) );
 }
 
+#ifdef STACK_USE_HASH_TREE
+
+//! @brief Number of elements covered by the hash tree, aggregates included.
+inline stacksize_t stack_hash_tree_elems_(const Stack *stk)
+{
+    return stk->capacity * (stacksize_t) STACK_DATA_ARRAYS_NUM;
+}
+
+inline stacksize_t stack_hash_tree_blocks_(const Stack *stk)
+{
+    return (stack_hash_tree_elems_(stk) + STACK_HASH_BLOCK_ELEMS - 1) / STACK_HASH_BLOCK_ELEMS;
+}
+
+inline stackhash_t stack_hash_block_(Stack *stk, stacksize_t block)
+{
+    stacksize_t first = block * STACK_HASH_BLOCK_ELEMS;
+    stacksize_t len = stack_hash_tree_elems_(stk) - first;
+    if (len > STACK_HASH_BLOCK_ELEMS) len = STACK_HASH_BLOCK_ELEMS;
+
+    return stack_compute_hash( (char *) (stk->data + first), (unsigned int) ((size_t) len*sizeof(Elem_t)) );
+}
+
+//! @brief Computes hash of an inner node of the tree from its two children.
+inline stackhash_t stack_hash_tree_node_(stackhash_t *tree, stacksize_t node)
+{
+    return stack_compute_hash( (char *) (tree + 2*node), 2*sizeof(stackhash_t) );
+}
+
+//! @brief Allocates (if the number of leaves has changed) and fills the whole hash tree.
+inline StackErrorCode stack_hash_tree_build_(Stack *stk)
+{
+    assert(stk);
+    assert(stk->data);
+
+    stacksize_t blocks = stack_hash_tree_blocks_(stk);
+    stacksize_t leaves = 1;
+    while (leaves < blocks) leaves *= 2;
+
+    if (leaves != stk->hash_tree_leaves || !stk->hash_tree)
+    {
+        free(stk->hash_tree);
+        stk->hash_tree = (stackhash_t *) calloc( 2*(size_t) leaves, sizeof(stackhash_t) );
+        stk->hash_tree_leaves = (stk->hash_tree) ? leaves : 0;
+        stk->hash_tree_capacity = -1;
+        if (!stk->hash_tree) return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+
+    for (stacksize_t block = 0; block < leaves; block++)
+    {
+        stk->hash_tree[leaves + block] = (block < blocks) ? stack_hash_block_(stk, block) : HASH_DEFAULT_VALUE;
+    }
+    for (stacksize_t node = leaves - 1; node >= 1; node--)
+    {
+        stk->hash_tree[node] = stack_hash_tree_node_(stk->hash_tree, node);
+    }
+    stk->hash_tree_capacity = stk->capacity;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//! @brief Rehashes one block and the path from its leaf to the root.
+inline void stack_hash_tree_update_block_(Stack *stk, stacksize_t block)
+{
+    stacksize_t node = stk->hash_tree_leaves + block;
+    stk->hash_tree[node] = stack_hash_block_(stk, block);
+
+    for (node /= 2; node >= 1; node /= 2)
+    {
+        stk->hash_tree[node] = stack_hash_tree_node_(stk->hash_tree, node);
+    }
+}
+
+struct StackHashTreeJob_
+{
+    Stack *stk;
+    stacksize_t block_begin;
+    stacksize_t block_end;
+    stacksize_t bad_blocks;
+};
+
+//! @brief Thread function: counts blocks in [block_begin, block_end) whose data doesn't match their leaves.
+inline void *stack_hash_tree_check_job_(void *job_pnt)
+{
+    StackHashTreeJob_ *job = (StackHashTreeJob_ *) job_pnt;
+
+    job->bad_blocks = 0;
+    for (stacksize_t block = job->block_begin; block < job->block_end; block++)
+    {
+        if ( job->stk->hash_tree[job->stk->hash_tree_leaves + block] != stack_hash_block_(job->stk, block) )
+            job->bad_blocks++;
+    }
+
+    return NULL;
+}
+
+//! @brief Threads which check blocks of big stacks. They are started by the first such check and live
+//! as long as the program. One stack at a time is checked by them, others are checked by their callers alone.
+struct StackHashPool_
+{
+    pthread_mutex_t busy = PTHREAD_MUTEX_INITIALIZER;   //< Захвачен потоком, чей стек сейчас проверяется.
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t job_added = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+
+    long workers = 0;
+    long jobs_num = 0;
+    long jobs_taken = 0;
+    long jobs_done = 0;
+    StackHashTreeJob_ jobs[STACK_HASH_MAX_THREADS] = {};
+};
+
+//! @brief The pool itself, one for the whole program.
+inline StackHashPool_ stack_hash_pool_;
+
+//! @brief Does jobs of the pool until none are left. Must be called with pool->lock locked.
+inline void stack_hash_pool_do_jobs_(StackHashPool_ *pool)
+{
+    while (pool->jobs_taken < pool->jobs_num)
+    {
+        StackHashTreeJob_ *job = pool->jobs + (pool->jobs_taken)++;
+
+        pthread_mutex_unlock(&pool->lock);
+        stack_hash_tree_check_job_(job);
+        pthread_mutex_lock(&pool->lock);
+
+        if ( ++(pool->jobs_done) == pool->jobs_num ) pthread_cond_signal(&pool->job_done);
+    }
+}
+
+inline void *stack_hash_pool_worker_(void *pool_pnt)
+{
+    StackHashPool_ *pool = (StackHashPool_ *) pool_pnt;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (pool->jobs_taken >= pool->jobs_num)
+        {
+            pthread_cond_wait(&pool->job_added, &pool->lock);
+        }
+        stack_hash_pool_do_jobs_(pool);
+    }
+
+    return NULL;
+}
+
+//! @brief Rehashes all data blocks, splitting the work with the pool for big stacks.
+//! @return Number of blocks whose data doesn't match their leaves in the tree.
+inline stacksize_t stack_hash_tree_count_bad_blocks_(Stack *stk)
+{
+    stacksize_t blocks = stack_hash_tree_blocks_(stk);
+    StackHashPool_ *pool = &stack_hash_pool_;
+
+    if ( blocks < STACK_HASH_PARALLEL_MIN_BLOCKS || pthread_mutex_trylock(&pool->busy) )
+    {
+        StackHashTreeJob_ job = { stk, 0, blocks, 0 };
+        stack_hash_tree_check_job_(&job);
+        return job.bad_blocks;
+    }
+
+    long jobs_num = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs_num > STACK_HASH_MAX_THREADS) jobs_num = STACK_HASH_MAX_THREADS;
+    if (jobs_num < 1) jobs_num = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->workers < jobs_num - 1)
+    {
+        pthread_t worker = {};
+        if ( pthread_create(&worker, NULL, stack_hash_pool_worker_, pool) ) break;
+        pthread_detach(worker);
+        pool->workers++;
+    }
+
+    for (long ind = 0; ind < jobs_num; ind++)
+    {
+        pool->jobs[ind] = { stk, blocks * ind / jobs_num, blocks * (ind + 1) / jobs_num, 0 };
+    }
+    pool->jobs_num = jobs_num;
+    pool->jobs_taken = 0;
+    pool->jobs_done = 0;
+    pthread_cond_broadcast(&pool->job_added);
+
+    // the caller does jobs too, so all of them are done even if no worker could be started
+    stack_hash_pool_do_jobs_(pool);
+    while (pool->jobs_done < pool->jobs_num)
+    {
+        pthread_cond_wait(&pool->job_done, &pool->lock);
+    }
+
+    stacksize_t bad_blocks = 0;
+    for (long ind = 0; ind < jobs_num; ind++)
+    {
+        bad_blocks += pool->jobs[ind].bad_blocks;
+    }
+    pool->jobs_num = 0;
+    pool->jobs_taken = 0;
+    pool->jobs_done = 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->busy);
+
+    return bad_blocks;
+}
+
+//! @brief Checks blocks with elements [first, last] of the tree against their leaves, and the paths
+//! from these leaves to the root.
+inline int stack_hash_tree_is_range_valid_(Stack *stk, stacksize_t first, stacksize_t last)
+{
+    for (stacksize_t block = first / STACK_HASH_BLOCK_ELEMS; block <= last / STACK_HASH_BLOCK_ELEMS; block++)
+    {
+        stacksize_t node = stk->hash_tree_leaves + block;
+        if ( stk->hash_tree[node] != stack_hash_block_(stk, block) ) return 0;
+
+        for (node /= 2; node >= 1; node /= 2)
+        {
+            if ( stk->hash_tree[node] != stack_hash_tree_node_(stk->hash_tree, node) ) return 0;
+        }
+    }
+
+    return 1;
+}
+
+#endif // STACK_USE_HASH_TREE
+
 int stack_is_hash_data_valid(Stack *stk)
 {
     assert(stk);
 
+#ifdef STACK_USE_HASH_TREE
+    if ( !stk->hash_tree || stk->hash_tree_capacity != stk->capacity ) return 0;
+    if ( stk->hash_data != stk->hash_tree[1] ) return 0;
+
+    for (stacksize_t node = stk->hash_tree_leaves - 1; node >= 1; node--)
+    {
+        if ( stk->hash_tree[node] != stack_hash_tree_node_(stk->hash_tree, node) ) return 0;
+    }
+
+    if ( stack_hash_tree_count_bad_blocks_(stk) == 0 ) return 1;
+#else
     if ( stk->hash_data == stack_compute_hash_data_(stk)) return 1;
+#endif
     return 0;
 }
 
+int stack_is_hash_top_valid_(Stack *stk)
+{
+    assert(stk);
+
+#ifdef STACK_USE_HASH_TREE
+    if ( !stk->hash_tree || stk->hash_tree_capacity != stk->capacity ) return 0;
+    if ( stk->hash_data != stk->hash_tree[1] ) return 0;
+
+    // elements size - 1 and size are the ones push and pop change
+    stacksize_t first = (stk->size > 0) ? stk->size - 1 : 0;
+    stacksize_t last = (stk->size < stk->capacity) ? stk->size : stk->capacity - 1;
+    if (first > last) return 1;
+
+    if ( !stack_hash_tree_is_range_valid_(stk, first, last) ) return 0;
+#ifdef STACK_USE_AGGREGATE
+    if ( !stack_hash_tree_is_range_valid_(stk, stk->capacity + first, stk->capacity + last) ) return 0;
+#endif
+
+    return 1;
+#else
+    return stack_is_hash_data_valid(stk);
+#endif
+}
+
 int stack_is_hash_struct_valid(Stack *stk)
 {
     assert(stk);
@@ -406,29 +840,65 @@ void stack_update_hash(Stack *stk)
 
     if (stk->data)
     {
+#ifdef STACK_USE_HASH_TREE
+        stk->hash_data = ( stack_hash_tree_build_(stk) ) ? HASH_DEFAULT_VALUE : stk->hash_tree[1];
+#else
         stk->hash_data = stack_compute_hash_data_(stk);
+#endif
     }
     else
     {
+#ifdef STACK_USE_HASH_TREE
+        free(stk->hash_tree);
+        stk->hash_tree = NULL;
+        stk->hash_tree_leaves = 0;
+        stk->hash_tree_capacity = -1;
+#endif
         stk->hash_data = HASH_DEFAULT_VALUE;
     }
 
     stk->hash_struct = HASH_DEFAULT_VALUE;
     stk->hash_struct = stack_compute_hash_struct_(stk);
 }
+
+void stack_update_hash_elem_(Stack *stk, stacksize_t ind)
+{
+    assert(stk);
+
+#ifdef STACK_USE_HASH_TREE
+    if ( stk->data && stk->hash_tree && stk->hash_tree_capacity == stk->capacity )
+    {
+        assert(0 <= ind && ind < stk->capacity);
+
+        stack_hash_tree_update_block_(stk, ind / STACK_HASH_BLOCK_ELEMS);
+#ifdef STACK_USE_AGGREGATE
+        stack_hash_tree_update_block_(stk, (stk->capacity + ind) / STACK_HASH_BLOCK_ELEMS);
+#endif
+        stk->hash_data = stk->hash_tree[1];
+
+        stk->hash_struct = HASH_DEFAULT_VALUE;
+        stk->hash_struct = stack_compute_hash_struct_(stk);
+        return;
+    }
+#else
+    (void) ind;
+#endif
+
+    stack_update_hash(stk);
+}
 #endif
 
 
 //---------------------------------------------------------------------------------------------------------------
 
-#ifdef STACK_DO_DUMP
+#ifdef STACK_KEEP_ORIGIN_
 #define stack_ctor(stk) stack_ctor_(stk, #stk, __FILE__, __LINE__, __func__)
 #else
 #define stack_ctor(stk) stack_ctor_(stk)
 #endif
 
 StackErrorCode stack_ctor_( Stack *stk
-#ifdef STACK_DO_DUMP
+#ifdef STACK_KEEP_ORIGIN_
                             ,
                             const char *stack_name,
                             const char *orig_file_name,
@@ -442,15 +912,24 @@ StackErrorCode stack_ctor_( Stack *stk
     stack_dtor(stk);
 
     stk->data = NULL;
+#ifdef STACK_USE_AGGREGATE
+    stk->aggr = NULL;
+#endif
     stk->p_origin = NULL;
     stk->capacity = 0;
     stk->size = 0;
-#ifdef STACK_DO_DUMP
+#ifdef STACK_KEEP_ORIGIN_
     stk->stack_name = stack_name;
     stk->orig_file_name = orig_file_name;
     stk->orig_line = orig_line;
     stk->orig_func_name = orig_func_name;
 #endif
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+    stk->callsite = (orig_file_name && orig_func_name) ? stack_adaptive_find_(orig_file_name, orig_line, orig_func_name, 1)
+                                                       : NULL;
+    stk->peak_size = 0;
+    stk->min_capacity = (stk->callsite) ? stack_adaptive_capacity_(stk->callsite) : 0;
+#endif
 #ifdef STACK_USE_PROTECTION_CANARY
     stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
     stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
@@ -466,13 +945,28 @@ StackErrorCode stack_dtor(Stack *stk)
 {
     if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
 
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+    if (stk->callsite && stk->peak_size >= 0) stack_adaptive_record_(stk->callsite, stk->peak_size);
+    stk->callsite = NULL;
+    stk->peak_size = -1;
+    stk->min_capacity = -1;
+#endif
+
     stk->capacity = -1;
     stk->size = -1;
+#ifdef STACK_USE_VIRTUAL_MEMORY
+    if (stk->p_origin) munmap(stk->p_origin, STACK_VM_RESERVE_SIZE);
+    stk->vm_committed = 0;
+#else
     if (stk->p_origin) free(stk->p_origin);
+#endif
     stk->p_origin = NULL;
     stk->data = NULL;
+#ifdef STACK_USE_AGGREGATE
+    stk->aggr = NULL;
+#endif
 
-#ifdef STACK_DO_DUMP
+#ifdef STACK_KEEP_ORIGIN_
     stk->stack_name = NULL;
     stk->orig_file_name = NULL;
     stk->orig_line = -1;
@@ -491,47 +985,69 @@ StackErrorCode stack_dtor(Stack *stk)
     stk->hash_struct = HASH_DEFAULT_VALUE;
     stk->hash_data = HASH_DEFAULT_VALUE;
 #endif
+#ifdef STACK_USE_HASH_TREE
+    free(stk->hash_tree);
+    stk->hash_tree = NULL;
+    stk->hash_tree_leaves = 0;
+    stk->hash_tree_capacity = -1;
+#endif
 
     return STACK_ERROR_NO_ERROR;
 }
 
 StackErrorCode stack_push(Stack *stk, Elem_t value)
 {
-    STACK_CHECK(stk)
+    STACK_CHECK_TOP(stk)
 
-    StackErrorCode mem_realloc_res = stack_realloc(stk); // сам stack_realloc определяет, нужно ли делать realloc
+    StackErrorCode mem_realloc_res = stack_realloc_(stk); // сам stack_realloc_ определяет, нужно ли делать realloc
     if ( mem_realloc_res )
     {
         return mem_realloc_res;
     }
 
+#ifdef STACK_USE_AGGREGATE
+    (stk->aggr)[stk->size] = (stk->size > 0) ? aggregate_elem_t( (stk->aggr)[stk->size - 1], value ) : value;
+#endif
     (stk->data)[(stk->size)++] = value;
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+    if (stk->size > stk->peak_size) stk->peak_size = stk->size;
+#endif
 
 #ifdef STACK_USE_PROTECTION_HASH
-    stack_update_hash(stk);
+    stack_update_hash_elem_(stk, stk->size - 1);
 #endif
 
     return STACK_ERROR_NO_ERROR;
 }
 
 #ifdef STACK_USE_POISON
-inline void fill_with_poison_(Stack *stk, stacksize_t ind)
+inline void fill_elem_with_poison_(Elem_t *elem)
 {
-    assert(stk);
-    assert(0 <= ind && ind < stk->capacity);
+    assert(elem);
 
-    poison_t *ptr = (poison_t *) (stk->data + ind);
+    poison_t *ptr = (poison_t *) elem;
     for (size_t i = 0; i < sizeof(Elem_t)/sizeof(poison_t); i++)
     {
         *ptr = POISON_VALUE;
         ptr += 1;
     }
 }
+
+inline void fill_with_poison_(Stack *stk, stacksize_t ind)
+{
+    assert(stk);
+    assert(0 <= ind && ind < stk->capacity);
+
+    fill_elem_with_poison_(stk->data + ind);
+#ifdef STACK_USE_AGGREGATE
+    fill_elem_with_poison_(stk->aggr + ind);
+#endif
+}
 #endif
 
 StackErrorCode stack_pop(Stack *stk, Elem_t *ret_value)
 {
-    STACK_CHECK(stk)
+    STACK_CHECK_TOP(stk)
     if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
 
     if (stk->size == 0)
@@ -548,22 +1064,37 @@ StackErrorCode stack_pop(Stack *stk, Elem_t *ret_value)
 #endif
 
 #ifdef STACK_USE_PROTECTION_HASH
-    stack_update_hash(stk);
+    stack_update_hash_elem_(stk, stk->size);
+    stacksize_t old_capacity = stk->capacity;
 #endif
 
-    StackErrorCode mem_realloc_res = stack_realloc(stk); // сам stack_realloc определяет, нужно ли делать realloc
+    StackErrorCode mem_realloc_res = stack_realloc_(stk); // сам stack_realloc_ определяет, нужно ли делать realloc
     if ( mem_realloc_res )
     {
         return mem_realloc_res;
     }
 
 #ifdef STACK_USE_PROTECTION_HASH
-    stack_update_hash(stk);
+    if (stk->capacity != old_capacity) stack_update_hash(stk);
 #endif
 
     return STACK_ERROR_NO_ERROR;
 }
 
+#ifdef STACK_USE_AGGREGATE
+StackErrorCode stack_aggregate(Stack *stk, Elem_t *ret_value)
+{
+    STACK_CHECK_TOP(stk)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+
+    if (stk->size == 0) return STACK_ERROR_NOTHING_TO_POP;
+
+    *ret_value = stk->aggr[stk->size - 1];
+
+    return STACK_ERROR_NO_ERROR;
+}
+#endif
+
 //-------------------------------------------------------------------------------------------------------
 
 #ifdef STACK_USE_POISON
@@ -576,39 +1107,51 @@ inline void fill_up_with_poison_(Stack *stk, stacksize_t start_with_index)
 }
 #endif
 
-inline StackErrorCode stack_realloc_helper_( Stack *stk, Elem_t **new_data_p, void **p_new_origin )
+//! @brief Returns the size of memory block, which is enough to hold data of data_bytes bytes
+//! aligned by data_align, together with data canaries around it (if they are turned on).
+inline size_t stack_data_block_size_( size_t data_bytes, size_t data_align )
 {
-    assert(stk);
-    assert(new_data_p);
-    assert(p_new_origin);
-
-    size_t calloc_first_arg = (size_t) stk->capacity;
-    size_t calloc_second_arg = sizeof(Elem_t);
 #ifdef STACK_USE_PROTECTION_CANARY
-    calloc_first_arg = 3 + (stk->capacity + 1)*sizeof(Elem_t) / sizeof(canary_t);
-    calloc_second_arg = sizeof(canary_t);
+    return 3*sizeof(canary_t) + data_align + data_bytes;
+#else
+    (void) data_align;
+    return data_bytes;
 #endif
+}
 
-    void *p_calloc = (void *) calloc( calloc_first_arg, calloc_second_arg );
-    if (!p_calloc) return STACK_ERROR_MEM_BAD_REALLOC;
+//! @brief Lays out data canaries and data of data_bytes bytes in the memory block starting at
+//! p_origin, which must be at least stack_data_block_size_() bytes long.
+//! @return Pointer to the beginning of data, aligned by data_align.
+inline char *stack_place_data_( void *p_origin, size_t data_bytes, size_t data_align
+#ifdef STACK_USE_PROTECTION_CANARY
+                                ,
+                                canary_t **p_data_canary_left,
+                                canary_t **p_data_canary_right
+#endif
+                              )
+{
+    assert(p_origin);
 
-    Elem_t *new_data = (Elem_t *) p_calloc;
+    char *new_data = (char *) p_origin;
 #ifdef STACK_USE_PROTECTION_CANARY
-    stk->p_data_canary_left = (canary_t *) p_calloc;
+    assert(p_data_canary_left);
+    assert(p_data_canary_right);
+
+    *p_data_canary_left = (canary_t *) p_origin;
 
-    char *p_left_canary_end = ((char *) p_calloc) + sizeof(canary_t);
+    char *p_left_canary_end = ((char *) p_origin) + sizeof(canary_t);
 
-    size_t empty_space_between_left_canary_and_data = sizeof(Elem_t) - ((__PTRDIFF_TYPE__)( p_left_canary_end ) % sizeof(Elem_t));
-    if ( empty_space_between_left_canary_and_data == sizeof(Elem_t) ) empty_space_between_left_canary_and_data = 0;
-    new_data = (Elem_t *)(((char *) p_left_canary_end) + empty_space_between_left_canary_and_data);
+    size_t empty_space_between_left_canary_and_data = data_align - ((__PTRDIFF_TYPE__)( p_left_canary_end ) % data_align);
+    if ( empty_space_between_left_canary_and_data == data_align ) empty_space_between_left_canary_and_data = 0;
+    new_data = p_left_canary_end + empty_space_between_left_canary_and_data;
 
-    char *p_data_end = (char *)(new_data + stk->capacity);
+    char *p_data_end = new_data + data_bytes;
     size_t empty_space_between_data_and_right_canary = sizeof(canary_t) - ((__PTRDIFF_TYPE__)( p_data_end ) % sizeof(canary_t));
     if (empty_space_between_data_and_right_canary == sizeof(canary_t)) empty_space_between_data_and_right_canary = 0;
-    stk->p_data_canary_right = (canary_t *)(((char *) p_data_end) + empty_space_between_data_and_right_canary);
+    *p_data_canary_right = (canary_t *)(p_data_end + empty_space_between_data_and_right_canary);
 
-    *(stk->p_data_canary_left) = CANARY_LEFT_DEFAULT_VALUE;
-    *(stk->p_data_canary_right) = CANARY_RIGHT_DEFAULT_VALUE;
+    **p_data_canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    **p_data_canary_right = CANARY_RIGHT_DEFAULT_VALUE;
 #ifdef STACK_FULL_DEBUG_INFO
     printf( "Realloc hepler info:\n"
             "p_left_canary_end = %p\n"
@@ -623,37 +1166,133 @@ inline StackErrorCode stack_realloc_helper_( Stack *stk, Elem_t **new_data_p, vo
                                                         (void *) new_data,
                                                         (void *) p_data_end,
                                                         empty_space_between_data_and_right_canary,
-                                                        (void *) stk->p_data_canary_right,
-                                                        *(stk->p_data_canary_left),
-                                                        *(stk->p_data_canary_right) );
+                                                        (void *) *p_data_canary_right,
+                                                        **p_data_canary_left,
+                                                        **p_data_canary_right );
 #endif
-    assert( ((__PTRDIFF_TYPE__)new_data)%sizeof(Elem_t) == 0);
-    assert( ((__PTRDIFF_TYPE__) stk->p_data_canary_left )%sizeof(canary_t) == 0 );
-    assert( ((__PTRDIFF_TYPE__) stk->p_data_canary_right )%sizeof(canary_t) == 0 );
-    assert( (size_t) ((char *)stk->p_data_canary_right + sizeof(canary_t) - (char *)p_calloc)
-        <= calloc_first_arg*calloc_second_arg );
+    assert( ((__PTRDIFF_TYPE__)new_data)%data_align == 0);
+    assert( ((__PTRDIFF_TYPE__) *p_data_canary_left )%sizeof(canary_t) == 0 );
+    assert( ((__PTRDIFF_TYPE__) *p_data_canary_right )%sizeof(canary_t) == 0 );
+    assert( (size_t) ((char *) *p_data_canary_right + sizeof(canary_t) - (char *) p_origin)
+        <= stack_data_block_size_(data_bytes, data_align) );
+#else
+    (void) data_bytes;
+    (void) data_align;
 #endif
 
-    *new_data_p = new_data;
+    return new_data;
+}
+
+#ifndef STACK_USE_VIRTUAL_MEMORY
+inline StackErrorCode stack_realloc_helper_( Stack *stk, Elem_t **new_data_p, void **p_new_origin )
+{
+    assert(stk);
+    assert(new_data_p);
+    assert(p_new_origin);
+
+    size_t data_bytes = ((size_t) stk->capacity)*STACK_DATA_ARRAYS_NUM*sizeof(Elem_t);
+
+    void *p_calloc = (void *) calloc( stack_data_block_size_(data_bytes, sizeof(Elem_t)), 1 );
+    if (!p_calloc) return STACK_ERROR_MEM_BAD_REALLOC;
+
+    *new_data_p = (Elem_t *) stack_place_data_( p_calloc, data_bytes, sizeof(Elem_t)
+#ifdef STACK_USE_PROTECTION_CANARY
+                                                , &stk->p_data_canary_left, &stk->p_data_canary_right
+#endif
+                                              );
     *p_new_origin = p_calloc;
 
     return STACK_ERROR_NO_ERROR;
 }
 
+#else // STACK_USE_VIRTUAL_MEMORY is turned on
+
+//! @brief Rounds the number of bytes to commit up to the page size, or up to the
+//! huge page size when the region is big enough to be backed by huge pages.
+inline size_t stack_vm_round_commit_( size_t bytes )
+{
+    size_t granule = (size_t) sysconf(_SC_PAGESIZE);
+    if (bytes >= STACK_VM_HUGE_PAGE_SIZE) granule = STACK_VM_HUGE_PAGE_SIZE;
+
+    return (bytes + granule - 1) / granule * granule;
+}
+
+//! @brief Makes the committed part of the reserved region match stk->capacity. On the first
+//! call reserves STACK_VM_RESERVE_SIZE bytes of address space. Growing commits new pages with
+//! mprotect(), shrinking returns pages with madvise(MADV_DONTNEED). Data never moves.
+inline StackErrorCode stack_vm_commit_( Stack *stk )
+{
+    assert(stk);
+
+    size_t data_bytes = ((size_t) stk->capacity)*sizeof(Elem_t);
+    size_t need = stack_vm_round_commit_( stack_data_block_size_(data_bytes, sizeof(Elem_t)) );
+    if (need > STACK_VM_RESERVE_SIZE) return STACK_ERROR_MEM_BAD_REALLOC;
+
+    if (!stk->p_origin)
+    {
+        void *p_reserved = mmap(NULL, STACK_VM_RESERVE_SIZE, PROT_NONE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p_reserved == MAP_FAILED) return STACK_ERROR_MEM_BAD_REALLOC;
+#ifdef MADV_HUGEPAGE
+        madvise(p_reserved, STACK_VM_RESERVE_SIZE, MADV_HUGEPAGE); // only a hint, failure is fine
+#endif
+        stk->p_origin = p_reserved;
+        stk->vm_committed = 0;
+    }
+
+    char *p_origin = (char *) stk->p_origin;
+    if (need > stk->vm_committed)
+    {
+        if ( mprotect(p_origin + stk->vm_committed, need - stk->vm_committed, PROT_READ | PROT_WRITE) )
+            return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+    else if (need < stk->vm_committed)
+    {
+        madvise(p_origin + need, stk->vm_committed - need, MADV_DONTNEED);
+        mprotect(p_origin + need, stk->vm_committed - need, PROT_NONE);
+    }
+    stk->vm_committed = need;
+
+    stk->data = (Elem_t *) stack_place_data_( p_origin, data_bytes, sizeof(Elem_t)
+#ifdef STACK_USE_PROTECTION_CANARY
+                                              , &stk->p_data_canary_left, &stk->p_data_canary_right
+#endif
+                                            );
+
+    return STACK_ERROR_NO_ERROR;
+}
+#endif // STACK_USE_VIRTUAL_MEMORY
+
 //! @brief Doubles (if MEM_MULTIPLIER == 2) the capacity of the stack, allocates new memory,
 //! moves data to the new place, frees old memory. Supports case when data pointer
 //! equals NULL and capacity == 0.
+//! With STACK_USE_VIRTUAL_MEMORY only commits more pages, data is neither moved nor copied.
 inline StackErrorCode stack_realloc_up_( Stack *stk, const int MEM_MULTIPLIER )
 {
+    stacksize_t old_capacity = stk->capacity;
     if (stk->capacity == 0)
     {
         stk->capacity = 1;
     }
     stk->capacity = MEM_MULTIPLIER * stk->capacity;
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+    if (stk->capacity < stk->min_capacity) stk->capacity = stk->min_capacity;
+#endif
 
+#ifdef STACK_USE_VIRTUAL_MEMORY
+    if ( stack_vm_commit_(stk) )
+    {
+        stk->capacity = old_capacity;
+        return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+#else
     Elem_t *new_data = NULL;
     void *p_new_origin = NULL;
-    if ( stack_realloc_helper_(stk, &new_data, &p_new_origin) ) return STACK_ERROR_MEM_BAD_REALLOC;
+    if ( stack_realloc_helper_(stk, &new_data, &p_new_origin) )
+    {
+        stk->capacity = old_capacity;
+        return STACK_ERROR_MEM_BAD_REALLOC;
+    }
     assert(new_data);
     assert(p_new_origin);
 
@@ -669,13 +1308,20 @@ inline StackErrorCode stack_realloc_up_( Stack *stk, const int MEM_MULTIPLIER )
         printf("@@@\n");
 #endif
         memcpy(new_data, stk->data, (stk->size)*sizeof(Elem_t));
+#ifdef STACK_USE_AGGREGATE
+        memcpy(new_data + stk->capacity, stk->aggr, (stk->size)*sizeof(Elem_t));
+#endif
     }
     if (stk->p_origin)
     {
         free(stk->p_origin);
     }
     stk->data = new_data;
+#ifdef STACK_USE_AGGREGATE
+    stk->aggr = new_data + stk->capacity;
+#endif
     stk->p_origin = p_new_origin;
+#endif // STACK_USE_VIRTUAL_MEMORY
 
 #ifdef STACK_USE_POISON
     fill_up_with_poison_(stk, stk->size);
@@ -695,14 +1341,26 @@ inline StackErrorCode stack_realloc_up_( Stack *stk, const int MEM_MULTIPLIER )
 
 //! @brief Divides by two (if MEM_MULTIPLIER == 2) the capacity of the stack,
 //! allocates new memory, moves data to the new place, frees old memory.
+//! With STACK_USE_VIRTUAL_MEMORY data stays in place and the tail pages are returned to the OS.
 inline StackErrorCode stack_realloc_down_(Stack *stk, const int MEM_MULTIPLIER)
 {
+    stacksize_t old_capacity = stk->capacity;
     stk->capacity = (stk->capacity) / MEM_MULTIPLIER;
 
+#ifdef STACK_USE_VIRTUAL_MEMORY
+    if ( stack_vm_commit_(stk) )
+    {
+        stk->capacity = old_capacity;
+        return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+#else
     Elem_t *new_data = NULL;
     void *p_new_origin = NULL;
     if ( stack_realloc_helper_(stk, &new_data, &p_new_origin) )
+    {
+        stk->capacity = old_capacity;
         return STACK_ERROR_MEM_BAD_REALLOC;
+    }
 
     assert(new_data);
     assert(p_new_origin);
@@ -718,11 +1376,22 @@ inline StackErrorCode stack_realloc_down_(Stack *stk, const int MEM_MULTIPLIER)
 #endif
 
     if (stk->size > 0) memcpy(new_data, stk->data, ((size_t) stk->size)*sizeof(Elem_t));
+#ifdef STACK_USE_AGGREGATE
+    if (stk->size > 0) memcpy(new_data + stk->capacity, stk->aggr, ((size_t) stk->size)*sizeof(Elem_t));
+#endif
 
     free(stk->p_origin);
 
     stk->data = new_data;
+#ifdef STACK_USE_AGGREGATE
+    stk->aggr = new_data + stk->capacity;
+#endif
+    stk->p_origin = p_new_origin;
+#endif // STACK_USE_VIRTUAL_MEMORY
 
+#ifdef STACK_USE_POISON
+    fill_up_with_poison_(stk, stk->size);
+#endif
 #ifdef STACK_FULL_DEBUG_INFO
     printf("@@@ end of realloc down\n");
     for (stacksize_t ind = 0; ind < stk->capacity; ind++)
@@ -738,19 +1407,36 @@ inline StackErrorCode stack_realloc_down_(Stack *stk, const int MEM_MULTIPLIER)
 
 StackErrorCode stack_realloc(Stack *stk)
 {
-    STACK_CHECK(stk)
+    STACK_CHECK_TOP(stk)
+
+    return stack_realloc_(stk);
+}
 
+StackErrorCode stack_realloc_(Stack *stk)
+{
     const int MEM_MULTIPLIER = 2;
 
+    // the whole data is copied and rehashed below, so it is checked in full first;
+    // without the hash tree STACK_CHECK_TOP() in the callers has already done it
     if ( stk->size >= stk->capacity )
     {
+#ifdef STACK_USE_HASH_TREE
+        STACK_CHECK(stk)
+#endif
         StackErrorCode realloc_up_res = stack_realloc_up_(stk, MEM_MULTIPLIER);
-        if (!realloc_up_res) return realloc_up_res;
+        if (realloc_up_res) return realloc_up_res;
     }
-    else if ( stk->size > 0 && stk->size * ( MEM_MULTIPLIER * MEM_MULTIPLIER ) <= stk->capacity )
+    else if ( stk->size > 0 && stk->size * ( MEM_MULTIPLIER * MEM_MULTIPLIER ) <= stk->capacity
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+              && stk->capacity / MEM_MULTIPLIER >= stk->min_capacity
+#endif
+            )
     {
+#ifdef STACK_USE_HASH_TREE
+        STACK_CHECK(stk)
+#endif
         StackErrorCode realloc_down_res = stack_realloc_down_(stk, MEM_MULTIPLIER);
-        if (!realloc_down_res) return realloc_down_res;
+        if (realloc_down_res) return realloc_down_res;
     }
 
     return STACK_ERROR_NO_ERROR;
@@ -760,48 +1446,154 @@ StackErrorCode stack_realloc(Stack *stk)
 
 #ifdef STACK_DO_DUMP
 
-inline void stack_dump_data_( Stack *stk )
+//! @brief Prints one element of array data, marking it if its index equals size.
+inline void stack_dump_elem_( FILE *stream, const Elem_t *data, stacksize_t size, stacksize_t ind )
 {
-    fprintf(stderr, "\t{\n");
+    fprintf(stream, "\t\t[" STACKSIZE_T_SPECF "][%p]\t = <", ind, (const void *)(data + ind));
+    print_elem_t(stream, data[ind]);
+    fprintf(stream, ">");
 
-#ifdef STACK_USE_PROTECTION_CANARY
-    if ( stk->p_data_canary_left )
+#ifdef STACK_USE_POISON
+    if (ind >= size)
     {
-        fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_left,
-                                                                            *(stk->p_data_canary_left));
+        fprintf(stream, " (MAYBE POISON: <" POISON_T_SPECF ">)", *((const poison_t *) (data + ind)));
     }
 #endif
 
-    for (stacksize_t ind = 0; ind < stk->capacity; ind++)
+    if (size == ind) fprintf(stream, " <--");
+
+    fprintf(stream, "\n");
+}
+
+//! @brief Prints elements data[first]..data[last-1] of the array of capacity elements,
+//! marking the one at index size. If collapse_runs is non-zero, every run of bytewise
+//! identical elements (e.g. poison) is printed as its first element and one more line.
+inline void stack_dump_elems_( FILE *stream, const Elem_t *data, stacksize_t size, stacksize_t capacity,
+                               stacksize_t first, stacksize_t last, int collapse_runs )
+{
+    if (first > 0)
     {
-        fprintf(stderr, "\t\t[" STACKSIZE_T_SPECF "][%p]\t = <", ind, (void *)(stk->data + ind));
-        print_elem_t(stderr, stk->data[ind]);
-        fprintf(stderr, ">");
+        fprintf(stream, "\t\t... [0.." STACKSIZE_T_SPECF ") skipped\n", first);
+    }
 
-#ifdef STACK_USE_POISON
-        if (ind >= stk->size)
+    stacksize_t ind = first;
+    while (ind < last)
+    {
+        stack_dump_elem_(stream, data, size, ind);
+
+        stacksize_t run_end = ind + 1;
+        if (collapse_runs)
         {
-            fprintf(stderr, " (MAYBE POISON: <" POISON_T_SPECF ">)", *((int *) stk->data + ind));
+            // run is broken at size, so that the marked element is always printed
+            while ( run_end < last && run_end != size
+                 && memcmp(data + run_end, data + ind, sizeof(Elem_t)) == 0 )
+            {
+                run_end++;
+            }
+
+            if (run_end - ind > 1)
+            {
+                fprintf(stream, "\t\t... " STACKSIZE_T_SPECF " more identical elements [" STACKSIZE_T_SPECF
+                                ".." STACKSIZE_T_SPECF ")\n", run_end - ind - 1, ind + 1, run_end);
+            }
         }
-#endif
 
-        if (stk->size == ind) fprintf(stderr, " <--");
+        ind = run_end;
+    }
 
-        fprintf(stderr, "\n");
+    if (last < capacity)
+    {
+        fprintf(stream, "\t\t... [" STACKSIZE_T_SPECF ".." STACKSIZE_T_SPECF ") skipped\n", last, capacity);
     }
+}
+
+inline void stack_dump_data_( FILE *stream, Stack *stk, stacksize_t first, stacksize_t last, int collapse_runs )
+{
+    fprintf(stream, "\t{\n");
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->p_data_canary_left )
+    {
+        fprintf(stream, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) stk->p_data_canary_left,
+                                                                            *(stk->p_data_canary_left));
+    }
+#endif
+
+    stack_dump_elems_(stream, stk->data, stk->size, stk->capacity, first, last, collapse_runs);
+
+#ifdef STACK_USE_AGGREGATE
+    fprintf(stream, "\tAggregates aggr[%p]:\n", (void *) stk->aggr);
+    stack_dump_elems_(stream, stk->aggr, stk->size, stk->capacity, first, last, collapse_runs);
+#endif
 
 #ifdef STACK_USE_PROTECTION_CANARY
     if ( stk->p_data_canary_right )
     {
-        fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n",
+        fprintf(stream, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n",
                 (void *) stk->p_data_canary_right,
                 *(stk->p_data_canary_right));
     }
 #endif
 
-    fprintf(stderr, "\t}\n");
+    fprintf(stream, "\t}\n");
+}
+
+#ifdef STACK_USE_HASH_TREE
+//! @brief Prints range [first, last) of the hash tree's elements, telling data from aggregates.
+inline void stack_dump_elems_range_(FILE *stream, Stack *stk, stacksize_t first, stacksize_t last)
+{
+    if (first < stk->capacity)
+    {
+        fprintf(stream, "\t\tdata[" STACKSIZE_T_SPECF ".." STACKSIZE_T_SPECF ")\n",
+                first, (last < stk->capacity) ? last : stk->capacity);
+    }
+    if (last > stk->capacity)
+    {
+        fprintf(stream, "\t\taggr[" STACKSIZE_T_SPECF ".." STACKSIZE_T_SPECF ")\n",
+                ((first > stk->capacity) ? first : stk->capacity) - stk->capacity, last - stk->capacity);
+    }
 }
 
+//! @brief Rehashes every block and prints ranges of elements whose blocks don't match the hash tree.
+inline void stack_dump_damaged_blocks_(FILE *stream, Stack *stk)
+{
+    if ( !stk->hash_tree || stk->hash_tree_capacity != stk->capacity )
+    {
+        fprintf(stream, "\tHash tree is not built for current capacity, damaged elements can't be found.\n");
+        return;
+    }
+
+    fprintf(stream, "\tDamaged elements (by hash tree with blocks of %d elements):\n", STACK_HASH_BLOCK_ELEMS);
+
+    stacksize_t elems = stack_hash_tree_elems_(stk);
+    stacksize_t blocks = stack_hash_tree_blocks_(stk);
+    stacksize_t range_first = -1;
+    int is_found = 0;
+    for (stacksize_t block = 0; block <= blocks; block++)
+    {
+        int is_damaged = (block < blocks)
+                      && stk->hash_tree[stk->hash_tree_leaves + block] != stack_hash_block_(stk, block);
+
+        if (is_damaged && range_first < 0)
+        {
+            range_first = block * STACK_HASH_BLOCK_ELEMS;
+        }
+        else if (!is_damaged && range_first >= 0)
+        {
+            stacksize_t range_last = block * STACK_HASH_BLOCK_ELEMS;
+            stack_dump_elems_range_(stream, stk, range_first, (range_last < elems) ? range_last : elems);
+            range_first = -1;
+            is_found = 1;
+        }
+    }
+
+    if (!is_found)
+    {
+        fprintf(stream, "\t\tnone, all data blocks match the tree.\n");
+    }
+}
+#endif
+
 inline void print_curr_local_time_(FILE *stream)
 {
     time_t curr_time = time(NULL);
@@ -816,55 +1608,189 @@ inline void print_curr_local_time_(FILE *stream)
                                                         curr_local_time.tm_sec);
 }
 
-void stack_dump_(Stack *stk, int verify_res, const char *file, const int line, const char *func)
+//! @brief Prints the common beginning of every dump: time, verification result and origin.
+//! @param [in] kind Name of the dumped structure, e.g. "Stack".
+//! @param [in] stk Pointer to the dumped structure, only its value is printed.
+inline void stack_dump_header_( FILE *stream, const char *kind, const void *stk, int verify_res,
+                                const char *stack_name, const char *orig_file_name,
+                                int orig_line, const char *orig_func_name,
+                                const char *file, int line, const char *func )
 {
-    fprintf(stderr, "STACK DUMP at ");
-    print_curr_local_time_(stderr);
-    fprintf(stderr, "\n");
+    fprintf(stream, "STACK DUMP at ");
+    print_curr_local_time_(stream);
+    fprintf(stream, "\n");
+
+    print_verify_res(stream, verify_res);
+
+    fprintf(stream, "%s[%p] \"%s\" declared in %s(%d), in function %s. "
+                    "STACK_DUMP() called from %s(%d), from function %s.\n",    kind,
+                                                                                stk,
+                                                                                stack_name,
+                                                                                orig_file_name,
+                                                                                orig_line,
+                                                                                orig_func_name,
+                                                                                file, line, func);
+}
+
+//! @brief Opens a fully buffered stream writing to the same file as stream (or fd, if stream
+//! is NULL), so that the dump doesn't make a write() call per fprintf(), even to stderr.
+//! @return New stream, which must be closed with fclose(), or NULL if it can't be opened.
+inline FILE *stack_dump_open_buffered_( FILE *stream, int fd )
+{
+    if (stream)
+    {
+        fflush(stream);
+        fd = fileno(stream);
+    }
+    if (fd < 0) return NULL;
 
-    print_verify_res(stderr, verify_res);
+    int dup_fd = dup(fd);
+    if (dup_fd < 0) return NULL;
 
-    fprintf(stderr, "Stack[%p] \"%s\" declared in %s(%d), in function %s. "
-                    "STACK_DUMP() called from %s(%d), from function %s.\n", (void *)    stk,
-                                                                                        stk->stack_name,
-                                                                                        stk->orig_file_name,
-                                                                                        stk->orig_line,
-                                                                                        stk->orig_func_name,
-                                                                                        file, line, func);
+    FILE *buffered = fdopen(dup_fd, "w");
+    if (!buffered)
+    {
+        close(dup_fd);
+        return NULL;
+    }
+    setvbuf(buffered, NULL, _IOFBF, STACK_DUMP_BUFFER_SIZE);
 
+    return buffered;
+}
+
+inline void stack_dump_to_( FILE *stream, Stack *stk, int verify_res, const StackDumpOptions *opts,
+                            const char *file, const int line, const char *func )
+{
     if (!stk)
     {
-        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        stack_dump_header_(stream, "Stack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stream, "Stack pointer is NULL, no further information is accessible.\n");
         return;
     }
 
-    fprintf(stderr, "{\n");
+    stack_dump_header_( stream, "Stack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stream, "{\n");
 #ifdef STACK_USE_PROTECTION_CANARY
-    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
-    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+    fprintf(stream, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stream, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
 #endif
-    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+    fprintf(stream, "\tsize = <" STACKSIZE_T_SPECF ">\n"
                     "\tcapacity = <" STACKSIZE_T_SPECF ">\n"
                     "\tdata[%p]\n", stk->size, stk->capacity, (void *) stk->data);
+#ifdef STACK_USE_ADAPTIVE_CAPACITY
+    fprintf(stream, "\tpeak_size = <" STACKSIZE_T_SPECF ">\n"
+                    "\tmin_capacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcallsite[%p]\n", stk->peak_size, stk->min_capacity, (void *) stk->callsite);
+#endif
 #ifdef STACK_USE_PROTECTION_HASH
-    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+    fprintf(stream, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
                     "\thash_data = <" STACKHASH_T_SPECF ">\n", stk->hash_struct, stk->hash_data);
+#endif
+#ifdef STACK_USE_HASH_TREE
+    if ( stk->data && (verify_res & STACK_VERIFY_DATA_HASH_INVALID) )
+    {
+        stack_dump_damaged_blocks_(stream, stk);
+    }
 #endif
     if ( !(stk->data) )
     {
-        fprintf(stderr, "Data pointer is NULL. Data cannot be accessed.\n");
+        fprintf(stream, "Data pointer is NULL. Data cannot be accessed.\n");
         return;
     }
 
-    stack_dump_data_(stk);
+    stacksize_t first = opts->first;
+    stacksize_t last = (opts->last < 0) ? stk->capacity : opts->last;
+    if (opts->window >= 0)
+    {
+        first = stk->size - opts->window;
+        last = stk->size + opts->window;
+    }
+    if (first < 0) first = 0;
+    if (last > stk->capacity) last = stk->capacity;
+
+    stack_dump_data_(stream, stk, first, last, opts->collapse_runs);
+
+    fprintf(stream, "}\n");
+}
+
+void stack_dump_ex_( Stack *stk, int verify_res, const StackDumpOptions *opts,
+                     const char *file, const int line, const char *func )
+{
+    assert(opts);
+
+    FILE *stream = (opts->stream || opts->fd < 0) ? opts->stream : NULL;
+    if (!stream && opts->fd < 0) stream = stderr;
+
+    FILE *buffered = stack_dump_open_buffered_(stream, opts->fd);
+    if (!buffered && !stream) return;
 
-    fprintf(stderr, "}\n");
+    stack_dump_to_( (buffered) ? buffered : stream, stk, verify_res, opts, file, line, func );
+
+    if (buffered) fclose(buffered);
 
 #ifdef STACK_ABORT_ON_DUMP
     abort();
 #endif
 }
 
+void stack_dump_(Stack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    StackDumpOptions opts = {};
+#ifdef STACK_DUMP_WINDOW
+    opts.window = STACK_DUMP_WINDOW;
+    opts.collapse_runs = 1;
+#endif
+
+    stack_dump_ex_(stk, verify_res, &opts, file, line, func);
+}
+
+StackErrorCode stack_dump_raw(Stack *stk, FILE *stream)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (!stream) return STACK_ERROR_IO;
+
+    StackRawDumpHeader header = {};
+    memcpy(header.magic, STACK_RAW_DUMP_MAGIC, sizeof(header.magic));
+    header.version = STACK_RAW_DUMP_VERSION;
+    header.endian_check = STACK_RAW_DUMP_ENDIAN_CHECK;
+    header.elem_size = (uint32_t) sizeof(Elem_t);
+    header.arrays_num = (uint32_t) STACK_DATA_ARRAYS_NUM;
+    header.verify_res = (int32_t) stack_verify(stk);
+    header.size = stk->size;
+    header.capacity = (stk->data) ? stk->capacity : 0;
+#ifdef STACK_USE_PROTECTION_CANARY
+    header.flags |= STACK_RAW_DUMP_HAS_CANARY;
+    if (stk->data)
+    {
+        header.canary_data_left = *(stk->p_data_canary_left);
+        header.canary_data_right = *(stk->p_data_canary_right);
+    }
+#endif
+#ifdef STACK_USE_PROTECTION_HASH
+    header.flags |= STACK_RAW_DUMP_HAS_HASH;
+    header.hash_data = (uint64_t) stk->hash_data;
+#endif
+#ifdef STACK_USE_POISON
+    header.flags |= STACK_RAW_DUMP_HAS_POISON;
+    header.poison_value = POISON_VALUE;
+#endif
+#ifdef STACK_USE_AGGREGATE
+    header.flags |= STACK_RAW_DUMP_HAS_AGGREGATE;
+#endif
+
+    if ( fwrite(&header, sizeof(header), 1, stream) != 1 ) return STACK_ERROR_IO;
+
+    size_t elems_num = (size_t) header.capacity * STACK_DATA_ARRAYS_NUM;
+    if ( elems_num > 0 && fwrite(stk->data, sizeof(Elem_t), elems_num, stream) != elems_num )
+        return STACK_ERROR_IO;
+
+    if ( fflush(stream) ) return STACK_ERROR_IO;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
 #endif // STACK_DO_DUMP
 
 #endif // STACK_H
@@ -0,0 +1,257 @@
+#ifndef STACK_ADAPTIVE_H
+#define STACK_ADAPTIVE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+    Table of stack construction places for STACK_USE_ADAPTIVE_CAPACITY. It is included by stack.h.
+
+    Every place where stack_ctor() is called (file, line, function) gets an entry, which counts the
+    peak sizes of the stacks constructed there, rounded up to the capacity they needed: 0, 2, 4, 8, ...
+    A new stack from the same place starts with the capacity that was enough for STACK_ADAPTIVE_PERCENTILE
+    percents of the previous ones, as soon as there are at least STACK_ADAPTIVE_MIN_SAMPLES of them.
+
+    The table is a fixed open-addressing hash table, entries are claimed with compare-and-swap and
+    counters are increased atomically, so stacks may be constructed and destructed in many threads.
+    If the table is full, stacks from new places are not sized adaptively.
+
+    stack_adaptive_export() writes the table as text, one line per place:
+    <file> TAB <line> TAB <function> TAB <STACK_ADAPTIVE_BUCKETS counters separated by spaces>
+    stack_adaptive_import() adds counters from such text to the table, e.g. at the start of the program.
+*/
+
+#ifndef STACK_ADAPTIVE_TABLE_SIZE
+//! @brief Maximum number of places in the table, must be a power of 2.
+#define STACK_ADAPTIVE_TABLE_SIZE 256
+#endif
+
+#ifndef STACK_ADAPTIVE_PERCENTILE
+#define STACK_ADAPTIVE_PERCENTILE 90
+#endif
+
+#ifndef STACK_ADAPTIVE_MIN_SAMPLES
+#define STACK_ADAPTIVE_MIN_SAMPLES 4
+#endif
+
+//! @brief Counters for capacities 0, 2, 4, ..., 2^(STACK_ADAPTIVE_BUCKETS - 1); bigger peaks go to the last one.
+const int STACK_ADAPTIVE_BUCKETS = 32;
+
+const char STACK_ADAPTIVE_EXPORT_HEADER[] = "# stack adaptive capacity table v1\n";
+const size_t STACK_ADAPTIVE_LINE_SIZE = 4096;
+
+struct StackCallsite
+{
+    unsigned long long key;         //< Хеш места вызова, 0 у свободной записи.
+    int is_ready;                   //< file, line и func уже записаны.
+    const char *file;
+    int line;
+    const char *func;
+    unsigned long long peaks[STACK_ADAPTIVE_BUCKETS]; //< peaks[k] - сколько стеков обошлись емкостью 2^k (peaks[0] - пустые).
+};
+
+//! @brief The table itself, one for the whole program.
+inline StackCallsite stack_adaptive_table_[STACK_ADAPTIVE_TABLE_SIZE] = {};
+
+//! @brief Writes the table to the stream.
+//! @param [in] stream Stream to write to.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if writing has failed.
+inline StackErrorCode stack_adaptive_export(FILE *stream);
+
+//! @brief Adds counters written by stack_adaptive_export() to the table.
+//! @param [in] stream Stream to read from.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if the stream can't be read or parsed,
+//! STACK_ERROR_OVERFLOW if the table is full. Lines read before the error are kept.
+inline StackErrorCode stack_adaptive_import(FILE *stream);
+
+//-------------------------------------------------------------------------------------------------------
+
+inline unsigned long long stack_adaptive_key_(const char *file, int line, const char *func)
+{
+    unsigned long long key = 14695981039346656037ull; // FNV-1a
+    for (const char *chr = file; *chr; chr++) key = (key ^ (unsigned char) *chr) * 1099511628211ull;
+    key = (key ^ 0xFF) * 1099511628211ull;
+    for (const char *chr = func; *chr; chr++) key = (key ^ (unsigned char) *chr) * 1099511628211ull;
+    key = (key ^ (unsigned int) line) * 1099511628211ull;
+
+    return (key) ? key : 1;
+}
+
+//! @brief Finds the entry of the place, claiming a free one if is_insert is non-zero.
+//! A claimed entry keeps the pointers file and func, so they must live as long as the program.
+//! @return Pointer to the entry or NULL if there is no such entry, or if the table is full.
+inline StackCallsite *stack_adaptive_find_(const char *file, int line, const char *func, int is_insert)
+{
+    assert(file);
+    assert(func);
+
+    unsigned long long key = stack_adaptive_key_(file, line, func);
+
+    for (size_t probe = 0; probe < STACK_ADAPTIVE_TABLE_SIZE; probe++)
+    {
+        StackCallsite *entry = stack_adaptive_table_ + ((key + probe) & (STACK_ADAPTIVE_TABLE_SIZE - 1));
+        unsigned long long entry_key = __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE);
+
+        if (entry_key == 0)
+        {
+            if (!is_insert) return NULL;
+
+            if ( __atomic_compare_exchange_n(&entry->key, &entry_key, key, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+            {
+                entry->file = file;
+                entry->line = line;
+                entry->func = func;
+                __atomic_store_n(&entry->is_ready, 1, __ATOMIC_RELEASE);
+                return entry;
+            }
+            // entry_key now holds the key of the thread which has claimed the entry first
+        }
+
+        if (entry_key == key) return entry;
+    }
+
+    return NULL;
+}
+
+//! @brief Returns the index of the counter for the stack which has reached peak_size elements.
+inline int stack_adaptive_bucket_(long peak_size)
+{
+    if (peak_size <= 0) return 0;
+    if (peak_size <= 2) return 1;
+
+    int bucket = 64 - __builtin_clzll( (unsigned long long) (peak_size - 1) );
+
+    return (bucket < STACK_ADAPTIVE_BUCKETS) ? bucket : STACK_ADAPTIVE_BUCKETS - 1;
+}
+
+inline void stack_adaptive_record_(StackCallsite *entry, long peak_size)
+{
+    assert(entry);
+
+    __atomic_fetch_add(&entry->peaks[stack_adaptive_bucket_(peak_size)], 1, __ATOMIC_RELAXED);
+}
+
+//! @brief Returns the capacity enough for STACK_ADAPTIVE_PERCENTILE percents of the stacks
+//! constructed in the place, or 0 if there are too few of them.
+inline long stack_adaptive_capacity_(StackCallsite *entry)
+{
+    assert(entry);
+
+    unsigned long long peaks[STACK_ADAPTIVE_BUCKETS] = {};
+    unsigned long long total = 0;
+    for (int bucket = 0; bucket < STACK_ADAPTIVE_BUCKETS; bucket++)
+    {
+        peaks[bucket] = __atomic_load_n(&entry->peaks[bucket], __ATOMIC_RELAXED);
+        total += peaks[bucket];
+    }
+    if (total < STACK_ADAPTIVE_MIN_SAMPLES) return 0;
+
+    unsigned long long enough = (total * STACK_ADAPTIVE_PERCENTILE + 99) / 100;
+    unsigned long long counted = 0;
+    for (int bucket = 0; bucket < STACK_ADAPTIVE_BUCKETS; bucket++)
+    {
+        counted += peaks[bucket];
+        if (counted >= enough) return (bucket == 0) ? 0 : 1l << bucket;
+    }
+
+    return 1l << (STACK_ADAPTIVE_BUCKETS - 1);
+}
+
+StackErrorCode stack_adaptive_export(FILE *stream)
+{
+    if (!stream) return STACK_ERROR_BAD_ARG;
+
+    if ( fputs(STACK_ADAPTIVE_EXPORT_HEADER, stream) == EOF ) return STACK_ERROR_IO;
+
+    for (size_t ind = 0; ind < STACK_ADAPTIVE_TABLE_SIZE; ind++)
+    {
+        StackCallsite *entry = stack_adaptive_table_ + ind;
+        if ( !__atomic_load_n(&entry->is_ready, __ATOMIC_ACQUIRE) ) continue;
+
+        fprintf(stream, "%s\t%d\t%s\t", entry->file, entry->line, entry->func);
+        for (int bucket = 0; bucket < STACK_ADAPTIVE_BUCKETS; bucket++)
+        {
+            fprintf(stream, (bucket == 0) ? "%llu" : " %llu", __atomic_load_n(&entry->peaks[bucket], __ATOMIC_RELAXED));
+        }
+        fputc('\n', stream);
+    }
+
+    return ( fflush(stream) || ferror(stream) ) ? STACK_ERROR_IO : STACK_ERROR_NO_ERROR;
+}
+
+//! @brief Parses one line of the exported table and adds its counters to the table.
+inline StackErrorCode stack_adaptive_import_line_(char *line_str)
+{
+    assert(line_str);
+
+    char *file = line_str;
+    char *line_num = strchr(file, '\t');
+    if (!line_num) return STACK_ERROR_IO;
+    *(line_num++) = '\0';
+
+    char *func = strchr(line_num, '\t');
+    if (!func) return STACK_ERROR_IO;
+    *(func++) = '\0';
+
+    char *counters = strchr(func, '\t');
+    if (!counters) return STACK_ERROR_IO;
+    *(counters++) = '\0';
+
+    char *end = NULL;
+    int line = (int) strtol(line_num, &end, 10);
+    if (end == line_num || *end != '\0') return STACK_ERROR_IO;
+
+    unsigned long long peaks[STACK_ADAPTIVE_BUCKETS] = {};
+    for (int bucket = 0; bucket < STACK_ADAPTIVE_BUCKETS; bucket++)
+    {
+        peaks[bucket] = strtoull(counters, &end, 10);
+        if (end == counters) return STACK_ERROR_IO;
+        counters = end;
+    }
+
+    StackCallsite *entry = stack_adaptive_find_(file, line, func, 0);
+    if (!entry)
+    {
+        // the table keeps the names, so they get their own memory, which is never freed
+        char *file_copy = strdup(file);
+        char *func_copy = strdup(func);
+        if (file_copy && func_copy) entry = stack_adaptive_find_(file_copy, line, func_copy, 1);
+
+        if (!entry || entry->file != file_copy)
+        {
+            free(file_copy);
+            free(func_copy);
+        }
+        if (!entry) return (file_copy && func_copy) ? STACK_ERROR_OVERFLOW : STACK_ERROR_MEM_BAD_REALLOC;
+    }
+
+    for (int bucket = 0; bucket < STACK_ADAPTIVE_BUCKETS; bucket++)
+    {
+        __atomic_fetch_add(&entry->peaks[bucket], peaks[bucket], __ATOMIC_RELAXED);
+    }
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_adaptive_import(FILE *stream)
+{
+    if (!stream) return STACK_ERROR_BAD_ARG;
+
+    char line_str[STACK_ADAPTIVE_LINE_SIZE] = "";
+    while ( fgets(line_str, sizeof(line_str), stream) )
+    {
+        size_t len = strlen(line_str);
+        if (len > 0 && line_str[len - 1] == '\n') line_str[--len] = '\0';
+        else if (!feof(stream)) return STACK_ERROR_IO; // the line is too long
+
+        if (len == 0 || line_str[0] == '#') continue;
+
+        StackErrorCode import_res = stack_adaptive_import_line_(line_str);
+        if (import_res) return import_res;
+    }
+
+    return ferror(stream) ? STACK_ERROR_IO : STACK_ERROR_NO_ERROR;
+}
+
+#endif // STACK_ADAPTIVE_H
@@ -0,0 +1,1044 @@
+#ifndef STACK_ARRAY_H
+#define STACK_ARRAY_H
+
+#include <stdint.h>
+
+#include "stack.h"
+
+/*
+    Container of many small stacks sharing one arena. Every logical stack is described by
+    a 12-byte header (offset, size, capacity) instead of a whole Stack with its own allocation,
+    canaries and debug info, so a hundred thousand stacks take one allocation for elements
+    and one for headers.
+
+    With STACK_USE_PROTECTION_HASH the header grows to 16 bytes: it also keeps the hash of itself, its id
+    and the elements of its stack, and hash_headers keeps the sum of all these hashes. Push, pop, view, create
+    and destroy check and rehash only the stacks they work with; compacting and dumps check all of them.
+
+    Stacks are addressed by ids, which stay the same until the stack is destroyed. Ids of
+    destroyed stacks are reused by the next stack_array_create().
+
+    A stack which is full moves to the end of the arena with doubled capacity (or grows in place
+    if it is already the last one there); its old place becomes garbage. When garbage is at least
+    a half of the used arena, the arena is compacted instead of growing. stack_array_compact() does
+    it explicitly: stacks are repacked in id order, so iterating over ids reads the arena sequentially,
+    and the capacity of every stack is cut down to its size.
+
+    Pointers returned by stack_array_view() are valid only until the next push, create or compact.
+
+    USAGE:
+    StackArray arr = {};
+    stack_array_ctor(&arr, 0);
+
+    stacksize_t ids[100] = {};
+    stack_array_create(&arr, 100, 4, ids);      // 100 stacks, 4 elements reserved for each
+    stack_array_push(&arr, ids[0], value);
+    stack_array_pop(&arr, ids[0], &value);
+    stack_array_destroy(&arr, 100, ids);
+*/
+
+const stacksize_t STACK_ARRAY_MIN_CAPACITY = 4;
+const stacksize_t STACK_ARRAY_MAX_CAPACITY = INT32_MAX;
+const uint32_t STACK_ARRAY_FREE_ID = UINT32_MAX;
+const uint32_t STACK_ARRAY_DESTROY_MARK = 1u << 31;
+
+#ifdef STACK_DO_DUMP
+const stacksize_t STACK_ARRAY_DUMP_MAX_STACKS = 16;
+#endif
+
+struct StackArrayHeader
+{
+    uint32_t offset;    //< Индекс первого элемента в арене; у свободного заголовка - следующий свободный id.
+    uint32_t size;      //< Количество элементов; у свободного заголовка - STACK_ARRAY_FREE_ID.
+    uint32_t capacity;  //< Количество элементов, зарезервированных в арене.
+#ifdef STACK_USE_PROTECTION_HASH
+    uint32_t hash;      //< Хеш заголовка, id и элементов стека.
+#endif
+};
+
+struct StackArray
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    Elem_t *data = NULL;
+    stacksize_t used = -1;              //< Сколько элементов арены отдано стекам (вместе с мусором).
+    stacksize_t capacity = -1;          //< Размер арены в элементах.
+    stacksize_t garbage = -1;           //< Элементы, оставшиеся от переехавших и удаленных стеков.
+
+    StackArrayHeader *headers = NULL;
+    stacksize_t count = -1;             //< Количество заголовков, включая свободные.
+    stacksize_t headers_capacity = -1;
+    stacksize_t live = -1;              //< Количество существующих стеков.
+    stacksize_t free_head = -1;         //< Первый свободный id, -1 если свободных нет.
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t hash_headers = HASH_DEFAULT_VALUE;  //< Сумма хешей всех заголовков.
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+    void *p_origin = NULL;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t* p_data_canary_left = NULL;
+    canary_t* p_data_canary_right = NULL;
+
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks stack array's condition, including the hashes of all the stacks.
+//! Push, pop and view check only the stack they work with.
+//! @param [in] arr Stack array to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the array is fine.
+static int stack_array_verify(StackArray *arr);
+
+//! @brief Stack array constructor. ONLY FOR INTERNAL USE! USE MACRO stack_array_ctor()!
+//! @param [in] arr Pointer to stack array to construct.
+//! @param [in] arena_capacity Number of elements to allocate the arena for at once, may be 0.
+//! @return StackErrorCode enum value.
+StackErrorCode stack_array_ctor_( StackArray *arr, stacksize_t arena_capacity
+#ifdef STACK_DO_DUMP
+                                  ,
+                                  const char *stack_name,
+                                  const char *orig_file_name,
+                                  const int orig_line,
+                                  const char *orig_func_name
+#endif
+                                );
+
+//! @brief Stack array deconstructor, destroys all the stacks at once.
+//! @param [in] arr Pointer to stack array to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode stack_array_dtor(StackArray *arr);
+
+//! @brief Creates count empty stacks, reserving capacity elements for each of them.
+//! @param [in] arr Pointer to the stack array.
+//! @param [in] count Number of stacks to create.
+//! @param [in] capacity Initial capacity of every stack, may be 0.
+//! @param [in] ret_ids Array of at least count elements to put ids of new stacks to.
+//! @return StackErrorCode enum value.
+static StackErrorCode stack_array_create(StackArray *arr, stacksize_t count, stacksize_t capacity, stacksize_t *ret_ids);
+
+//! @brief Destroys count stacks. Nothing is destroyed if any of the ids is wrong.
+//! @param [in] arr Pointer to the stack array.
+//! @param [in] count Number of stacks to destroy.
+//! @param [in] ids Ids of the stacks.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if an id is wrong or repeated.
+static StackErrorCode stack_array_destroy(StackArray *arr, stacksize_t count, const stacksize_t *ids);
+
+//! @brief Pushes element to the stack id.
+//! @param [in] arr Pointer to the stack array.
+//! @param [in] id Id of the stack.
+//! @param [in] value Value to push.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if id is wrong.
+static StackErrorCode stack_array_push(StackArray *arr, stacksize_t id, Elem_t value);
+
+//! @brief Pops element from the stack id.
+//! @param [in] arr Pointer to the stack array.
+//! @param [in] id Id of the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if id is wrong.
+static StackErrorCode stack_array_pop(StackArray *arr, stacksize_t id, Elem_t *ret_value);
+
+//! @brief Gives read-only access to the elements of the stack id, from the bottom to the top.
+//! @param [in] arr Pointer to the stack array.
+//! @param [in] id Id of the stack.
+//! @param [in] ret_data Pointer to put the pointer to the bottom element to.
+//! @param [in] ret_size Pointer to put the size of the stack to.
+//! @return StackErrorCode enum value, STACK_ERROR_BAD_ARG if id is wrong.
+static StackErrorCode stack_array_view(StackArray *arr, stacksize_t id, const Elem_t **ret_data, stacksize_t *ret_size);
+
+//! @brief Repacks all stacks to a new arena in id order, dropping garbage and cutting
+//! capacities down to sizes.
+//! @param [in] arr Pointer to the stack array.
+//! @param [in] reserve Number of free elements to leave at the end of the arena for next pushes.
+//! @return StackErrorCode enum value.
+static StackErrorCode stack_array_compact(StackArray *arr, stacksize_t reserve);
+
+//! @brief Returns the number of bytes taken by the stack array with its arena and headers.
+static size_t stack_array_memory(const StackArray *arr);
+
+#ifndef STACK_DO_DUMP
+
+#define STACK_ARRAY_DUMP(arr, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define STACK_ARRAY_DUMP(arr, verify_res) stack_array_dump_( (arr), verify_res, __FILE__, __LINE__, __func__)
+
+static void stack_array_dump_(StackArray *arr, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//-----------------------------------STACK_ARRAY.CPP------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define STACK_ARRAY_CHECK(arr)    {                 \
+    int verify_res = stack_array_verify(arr);       \
+    if ( verify_res != 0 ) {                        \
+        STACK_ARRAY_DUMP(arr, verify_res);          \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+#define STACK_ARRAY_CHECK_STACK(arr, id)    {               \
+    int verify_res = stack_array_verify_stack_(arr, id);    \
+    if ( verify_res != 0 ) {                                \
+        STACK_ARRAY_DUMP(arr, verify_res);                  \
+        return STACK_ERROR_VERIFY;                          \
+    }                                                       \
+}
+
+#define STACK_ARRAY_CHECK_STACKS(arr, count, ids)    {              \
+    int verify_res = stack_array_verify_stacks_(arr, count, ids);   \
+    if ( verify_res != 0 ) {                                        \
+        STACK_ARRAY_DUMP(arr, verify_res);                          \
+        return STACK_ERROR_VERIFY;                                  \
+    }                                                               \
+}
+
+#define STACK_ARRAY_CHECK_FREE(arr, count)    {                 \
+    int verify_res = stack_array_verify_free_(arr, count);      \
+    if ( verify_res != 0 ) {                                    \
+        STACK_ARRAY_DUMP(arr, verify_res);                      \
+        return STACK_ERROR_VERIFY;                              \
+    }                                                           \
+}
+
+//! @brief Checks that id belongs to an existing stack with a sane header.
+//! A stack of zero capacity takes no room, so its offset may be left above the used arena
+//! when the stack below it is destroyed.
+inline int stack_array_is_id_valid_(const StackArray *arr, stacksize_t id)
+{
+    assert(arr);
+
+    if ( id < 0 || id >= arr->count ) return 0;
+
+    const StackArrayHeader *header = arr->headers + id;
+
+    return header->size != STACK_ARRAY_FREE_ID && header->size <= header->capacity
+        && ( header->capacity == 0 || (stacksize_t) header->offset + (stacksize_t) header->capacity <= arr->used );
+}
+
+#ifdef STACK_USE_POISON
+inline void stack_array_fill_with_poison_(StackArray *arr, stacksize_t first, stacksize_t last)
+{
+    assert(arr);
+
+    for (stacksize_t ind = first; ind < last; ind++)
+    {
+        fill_elem_with_poison_(arr->data + ind);
+    }
+}
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+//! @brief Hashes the header id together with the id and the elements of the stack.
+//! Elements of a broken header are not read.
+inline uint32_t stack_array_compute_hash_stack_(const StackArray *arr, stacksize_t id)
+{
+    assert(arr);
+
+    const StackArrayHeader *header = arr->headers + id;
+    uint32_t key[] = { header->offset, header->size, header->capacity, (uint32_t) id, 0 };
+    if ( stack_array_is_id_valid_(arr, id) && header->size > 0 )
+    {
+        key[4] = (uint32_t) stack_compute_hash( (char *) (arr->data + header->offset), (unsigned int) (header->size*sizeof(Elem_t)) );
+    }
+
+    return (uint32_t) stack_compute_hash( (char *) key, sizeof(key) );
+}
+
+inline stackhash_t stack_array_sum_hashes_(const StackArray *arr)
+{
+    assert(arr);
+
+    uint32_t sum = 0;
+    for (stacksize_t id = 0; id < arr->count; id++)
+    {
+        sum += arr->headers[id].hash;
+    }
+
+    return (stackhash_t) sum;
+}
+
+inline stackhash_t stack_array_compute_hash_struct_(StackArray *arr)
+{
+    assert(arr);
+
+    stackhash_t curr_hash = arr->hash_struct;
+    arr->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) arr, sizeof(*arr) );
+    arr->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+
+//! @brief Rehashes all the stacks, but not the struct.
+inline void stack_array_rehash_stacks_(StackArray *arr)
+{
+    assert(arr);
+
+    for (stacksize_t id = 0; id < arr->count; id++)
+    {
+        arr->headers[id].hash = stack_array_compute_hash_stack_(arr, id);
+    }
+    arr->hash_headers = stack_array_sum_hashes_(arr);
+}
+
+inline void stack_array_update_hash_(StackArray *arr)
+{
+    assert(arr);
+
+    stack_array_rehash_stacks_(arr);
+    arr->hash_struct = stack_array_compute_hash_struct_(arr);
+}
+
+//! @brief Rehashes the stack id, but not the struct, replacing its old hash in hash_headers.
+inline void stack_array_rehash_stack_(StackArray *arr, stacksize_t id)
+{
+    assert(arr);
+
+    uint32_t hash = stack_array_compute_hash_stack_(arr, id);
+    arr->hash_headers = (stackhash_t) (uint32_t) ( (uint32_t) arr->hash_headers - arr->headers[id].hash + hash );
+    arr->headers[id].hash = hash;
+}
+
+//! @brief Rehashes the stack id and the struct.
+inline void stack_array_update_hash_stack_(StackArray *arr, stacksize_t id)
+{
+    assert(arr);
+
+    stack_array_rehash_stack_(arr, id);
+    arr->hash_struct = stack_array_compute_hash_struct_(arr);
+}
+#endif
+
+//! @brief Checks everything but the headers and the elements.
+inline int stack_array_verify_struct_(StackArray *arr)
+{
+    assert(arr);
+
+    int error = 0;
+
+    if ( ( !(arr->data) && arr->capacity != 0 ) || ( !(arr->headers) && arr->headers_capacity != 0 ) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( arr->used < 0 || arr->used > arr->capacity || arr->garbage < 0 || arr->garbage > arr->used
+      || arr->count < 0 || arr->count > arr->headers_capacity || arr->live < 0 || arr->live > arr->count
+      || arr->free_head < -1 || arr->free_head >= arr->count || (arr->free_head == -1) != (arr->live == arr->count) )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+    if ( arr->capacity < 0 || arr->capacity > (stacksize_t) UINT32_MAX || arr->headers_capacity < 0 )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( arr->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || arr->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+
+    if ( arr->data && ( *(arr->p_data_canary_left) != CANARY_LEFT_DEFAULT_VALUE
+                     || *(arr->p_data_canary_right) != CANARY_RIGHT_DEFAULT_VALUE ) )
+    error |= STACK_VERIFY_CANARY_DATA_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( arr->hash_struct != stack_array_compute_hash_struct_(arr) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+int stack_array_verify(StackArray *arr)
+{
+    if ( !arr ) return STACK_VERIFY_NULL_PNT;
+
+    int error = stack_array_verify_struct_(arr);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( !(error & (STACK_VERIFY_DATA_PNT_WRONG | STACK_VERIFY_SIZE_INVALID)) )
+    {
+        for (stacksize_t id = 0; id < arr->count; id++)
+        {
+            if ( arr->headers[id].hash != stack_array_compute_hash_stack_(arr, id) )
+            {
+                error |= STACK_VERIFY_DATA_HASH_INVALID;
+                break;
+            }
+        }
+
+        if ( arr->hash_headers != stack_array_sum_hashes_(arr) )
+        error |= STACK_VERIFY_DATA_HASH_INVALID;
+    }
+#endif
+
+    return error;
+}
+
+//! @brief Checks the stack array like stack_array_verify(), but only the stack id of all the stacks.
+//! A wrong id is not an error here, it is left to the caller.
+inline int stack_array_verify_stack_(StackArray *arr, stacksize_t id)
+{
+    if ( !arr ) return STACK_VERIFY_NULL_PNT;
+
+    int error = stack_array_verify_struct_(arr);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( !(error & (STACK_VERIFY_DATA_PNT_WRONG | STACK_VERIFY_SIZE_INVALID)) && id >= 0 && id < arr->count
+      && arr->headers[id].hash != stack_array_compute_hash_stack_(arr, id) )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#else
+    (void) id;
+#endif
+
+    return error;
+}
+
+//! @brief Same as stack_array_verify_stack_(), but for count stacks with the given ids.
+inline int stack_array_verify_stacks_(StackArray *arr, stacksize_t count, const stacksize_t *ids)
+{
+    if ( !arr ) return STACK_VERIFY_NULL_PNT;
+
+    int error = stack_array_verify_struct_(arr);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( !(error & (STACK_VERIFY_DATA_PNT_WRONG | STACK_VERIFY_SIZE_INVALID)) && ids )
+    {
+        for (stacksize_t ind = 0; ind < count; ind++)
+        {
+            stacksize_t id = ids[ind];
+            if ( id >= 0 && id < arr->count && arr->headers[id].hash != stack_array_compute_hash_stack_(arr, id) )
+            {
+                error |= STACK_VERIFY_DATA_HASH_INVALID;
+                break;
+            }
+        }
+    }
+#else
+    (void) count;
+    (void) ids;
+#endif
+
+    return error;
+}
+
+//! @brief Checks the stack array like stack_array_verify(), but only the first count headers
+//! of the free list of all the stacks, the ones stack_array_create() is going to reuse.
+inline int stack_array_verify_free_(StackArray *arr, stacksize_t count)
+{
+    if ( !arr ) return STACK_VERIFY_NULL_PNT;
+
+    int error = stack_array_verify_struct_(arr);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( !(error & (STACK_VERIFY_DATA_PNT_WRONG | STACK_VERIFY_SIZE_INVALID)) )
+    {
+        stacksize_t id = arr->free_head;
+        for (stacksize_t ind = 0; ind < count && id >= 0; ind++)
+        {
+            const StackArrayHeader *header = arr->headers + id;
+            if ( header->hash != stack_array_compute_hash_stack_(arr, id) )
+            {
+                error |= STACK_VERIFY_DATA_HASH_INVALID;
+                break;
+            }
+
+            id = (header->offset == STACK_ARRAY_FREE_ID) ? -1 : (stacksize_t) header->offset;
+            if ( id >= arr->count )
+            {
+                error |= STACK_VERIFY_SIZE_INVALID;
+                break;
+            }
+        }
+    }
+#else
+    (void) count;
+#endif
+
+    return error;
+}
+
+//! @brief Allocates an arena of new_capacity elements and moves the current one to it.
+//! If repack is non-zero, stacks are packed in id order without garbage, and if fit is non-zero
+//! too, capacities are cut down to sizes.
+inline StackErrorCode stack_array_move_arena_(StackArray *arr, stacksize_t new_capacity, int repack, int fit)
+{
+    assert(arr);
+
+    size_t data_bytes = (size_t) new_capacity*sizeof(Elem_t);
+    void *p_new_origin = calloc( stack_data_block_size_(data_bytes, sizeof(Elem_t)), 1 );
+    if (!p_new_origin) return STACK_ERROR_MEM_BAD_REALLOC;
+
+    Elem_t *new_data = (Elem_t *) stack_place_data_( p_new_origin, data_bytes, sizeof(Elem_t)
+#ifdef STACK_USE_PROTECTION_CANARY
+                                                     , &arr->p_data_canary_left, &arr->p_data_canary_right
+#endif
+                                                   );
+
+#ifdef STACK_USE_POISON
+    for (stacksize_t ind = 0; ind < new_capacity; ind++)
+    {
+        fill_elem_with_poison_(new_data + ind);
+    }
+#endif
+
+    stacksize_t new_used = 0;
+    if (!repack)
+    {
+        if (arr->used > 0) memcpy(new_data, arr->data, (size_t) arr->used*sizeof(Elem_t));
+        new_used = arr->used;
+    }
+    else
+    {
+        for (stacksize_t id = 0; id < arr->count; id++)
+        {
+            StackArrayHeader *header = arr->headers + id;
+            if (header->size == STACK_ARRAY_FREE_ID) continue;
+
+            if (fit) header->capacity = header->size;
+            if (header->size > 0) memcpy(new_data + new_used, arr->data + header->offset, header->size*sizeof(Elem_t));
+            header->offset = (uint32_t) new_used;
+            new_used += header->capacity;
+        }
+        arr->garbage = 0;
+    }
+
+    if (arr->p_origin) free(arr->p_origin);
+    arr->p_origin = p_new_origin;
+    arr->data = new_data;
+    arr->capacity = new_capacity;
+    arr->used = new_used;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    // offsets have changed, callers have checked all the stacks before
+    if (repack) stack_array_rehash_stacks_(arr);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//! @brief Reserves elems elements at the end of the arena, compacting or growing it when needed.
+//! Offsets of all stacks may change, so all of them are checked before compacting.
+inline StackErrorCode stack_array_alloc_(StackArray *arr, stacksize_t elems, stacksize_t *ret_offset)
+{
+    assert(arr);
+    assert(ret_offset);
+
+    const int MEM_MULTIPLIER = 2;
+
+    if (arr->used + elems > arr->capacity)
+    {
+        stacksize_t need = arr->used - arr->garbage + elems;
+        if ( need > (stacksize_t) UINT32_MAX ) return STACK_ERROR_OVERFLOW;
+
+        stacksize_t new_capacity = arr->capacity;
+        if ( arr->garbage * MEM_MULTIPLIER < arr->used || need * MEM_MULTIPLIER > arr->capacity )
+        {
+            new_capacity = MEM_MULTIPLIER * ( (arr->capacity > need) ? arr->capacity : need );
+            if ( new_capacity < STACK_ARRAY_MIN_CAPACITY ) new_capacity = STACK_ARRAY_MIN_CAPACITY;
+            if ( new_capacity > (stacksize_t) UINT32_MAX ) new_capacity = (stacksize_t) UINT32_MAX;
+        }
+
+#ifdef STACK_USE_PROTECTION_HASH
+        if (arr->garbage > 0)
+        {
+            STACK_ARRAY_CHECK(arr)
+        }
+#endif
+
+        StackErrorCode move_res = stack_array_move_arena_(arr, new_capacity, arr->garbage > 0, 0);
+        if ( move_res ) return move_res;
+    }
+
+    *ret_offset = arr->used;
+    arr->used += elems;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//! @brief Gives the region of a destroyed or moved stack back to the arena.
+inline void stack_array_release_(StackArray *arr, stacksize_t offset, stacksize_t elems)
+{
+    assert(arr);
+
+    if (offset + elems == arr->used) arr->used -= elems;
+    else                             arr->garbage += elems;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define stack_array_ctor(arr, arena_capacity) stack_array_ctor_(arr, arena_capacity, #arr, __FILE__, __LINE__, __func__)
+#else
+#define stack_array_ctor(arr, arena_capacity) stack_array_ctor_(arr, arena_capacity)
+#endif
+
+StackErrorCode stack_array_ctor_( StackArray *arr, stacksize_t arena_capacity
+#ifdef STACK_DO_DUMP
+                                  ,
+                                  const char *stack_name,
+                                  const char *orig_file_name,
+                                  const int orig_line,
+                                  const char *orig_func_name
+#endif
+                                )
+{
+    if (!arr) return STACK_ERROR_NULL_STK_PNT_PASSED;
+    if (arena_capacity < 0 || arena_capacity > (stacksize_t) UINT32_MAX) return STACK_ERROR_BAD_ARG;
+
+    stack_array_dtor(arr);
+
+    arr->data = NULL;
+    arr->p_origin = NULL;
+    arr->capacity = 0;
+    arr->used = 0;
+    arr->garbage = 0;
+    arr->headers = NULL;
+    arr->count = 0;
+    arr->headers_capacity = 0;
+    arr->live = 0;
+    arr->free_head = -1;
+    if (arena_capacity > 0 && stack_array_move_arena_(arr, arena_capacity, 0, 0))
+    {
+        return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+#ifdef STACK_DO_DUMP
+    arr->stack_name = stack_name;
+    arr->orig_file_name = orig_file_name;
+    arr->orig_line = orig_line;
+    arr->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    arr->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    arr->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stack_array_update_hash_(arr);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_dtor(StackArray *arr)
+{
+    if (!arr) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    arr->capacity = -1;
+    arr->used = -1;
+    arr->garbage = -1;
+    if (arr->p_origin) free(arr->p_origin);
+    arr->p_origin = NULL;
+    arr->data = NULL;
+
+    if (arr->headers) free(arr->headers);
+    arr->headers = NULL;
+    arr->count = -1;
+    arr->headers_capacity = -1;
+    arr->live = -1;
+    arr->free_head = -1;
+
+#ifdef STACK_DO_DUMP
+    arr->stack_name = NULL;
+    arr->orig_file_name = NULL;
+    arr->orig_line = -1;
+    arr->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    arr->canary_left = 0;
+    arr->canary_right = 0;
+
+    arr->p_data_canary_left = NULL;
+    arr->p_data_canary_right = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    arr->hash_struct = HASH_DEFAULT_VALUE;
+    arr->hash_headers = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_create(StackArray *arr, stacksize_t count, stacksize_t capacity, stacksize_t *ret_ids)
+{
+    STACK_ARRAY_CHECK_FREE(arr, count)
+    if ( !ret_ids ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if ( count < 0 || capacity < 0 || capacity > STACK_ARRAY_MAX_CAPACITY ) return STACK_ERROR_BAD_ARG;
+
+    const int MEM_MULTIPLIER = 2;
+
+    stacksize_t new_headers = count - (arr->count - arr->live);
+    if ( arr->count + new_headers > (stacksize_t) UINT32_MAX ) return STACK_ERROR_OVERFLOW;
+    if ( arr->count + new_headers > arr->headers_capacity )
+    {
+        stacksize_t new_capacity = MEM_MULTIPLIER * arr->headers_capacity;
+        if ( new_capacity < arr->count + new_headers ) new_capacity = arr->count + new_headers;
+
+        StackArrayHeader *headers = (StackArrayHeader *) realloc( arr->headers, (size_t) new_capacity*sizeof(StackArrayHeader) );
+        if ( !headers ) return STACK_ERROR_MEM_BAD_REALLOC;
+
+        arr->headers = headers;
+        arr->headers_capacity = new_capacity;
+#ifdef STACK_USE_PROTECTION_HASH
+        arr->hash_struct = stack_array_compute_hash_struct_(arr);
+#endif
+    }
+
+    stacksize_t offset = 0;
+    StackErrorCode alloc_res = stack_array_alloc_(arr, count * capacity, &offset);
+    if ( alloc_res )
+    {
+        return alloc_res;
+    }
+
+    for (stacksize_t ind = 0; ind < count; ind++)
+    {
+        stacksize_t id = arr->free_head;
+        if (id >= 0)
+        {
+            arr->free_head = (arr->headers[id].offset == STACK_ARRAY_FREE_ID) ? -1 : (stacksize_t) arr->headers[id].offset;
+        }
+        else
+        {
+            id = (arr->count)++;
+            arr->headers[id] = {};
+        }
+
+        arr->headers[id].offset = (uint32_t) (offset + ind*capacity);
+        arr->headers[id].size = 0;
+        arr->headers[id].capacity = (uint32_t) capacity;
+        ret_ids[ind] = id;
+#ifdef STACK_USE_PROTECTION_HASH
+        stack_array_rehash_stack_(arr, id);
+#endif
+    }
+    arr->live += count;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    arr->hash_struct = stack_array_compute_hash_struct_(arr);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_destroy(StackArray *arr, stacksize_t count, const stacksize_t *ids)
+{
+    STACK_ARRAY_CHECK_STACKS(arr, count, ids)
+    if ( !ids ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if ( count < 0 ) return STACK_ERROR_BAD_ARG;
+
+    for (stacksize_t ind = 0; ind < count; ind++)
+    {
+        if ( !stack_array_is_id_valid_(arr, ids[ind]) ) return STACK_ERROR_BAD_ARG;
+    }
+
+    // Capacities never reach STACK_ARRAY_DESTROY_MARK, so it marks the headers to find a repeated id
+    // before anything is changed.
+    stacksize_t marked = 0;
+    for (; marked < count; marked++)
+    {
+        StackArrayHeader *header = arr->headers + ids[marked];
+        if (header->capacity & STACK_ARRAY_DESTROY_MARK) break;
+        header->capacity |= STACK_ARRAY_DESTROY_MARK;
+    }
+    for (stacksize_t ind = 0; ind < marked; ind++)
+    {
+        arr->headers[ids[ind]].capacity &= ~STACK_ARRAY_DESTROY_MARK;
+    }
+    if (marked < count) return STACK_ERROR_BAD_ARG;
+
+    for (stacksize_t ind = count - 1; ind >= 0; ind--)
+    {
+        StackArrayHeader *header = arr->headers + ids[ind];
+#ifdef STACK_USE_POISON
+        stack_array_fill_with_poison_(arr, header->offset, (stacksize_t) header->offset + (stacksize_t) header->capacity);
+#endif
+        stack_array_release_(arr, header->offset, header->capacity);
+
+        header->offset = (arr->free_head == -1) ? STACK_ARRAY_FREE_ID : (uint32_t) arr->free_head;
+        header->size = STACK_ARRAY_FREE_ID;
+        header->capacity = 0;
+        arr->free_head = ids[ind];
+#ifdef STACK_USE_PROTECTION_HASH
+        stack_array_rehash_stack_(arr, ids[ind]);
+#endif
+    }
+    arr->live -= count;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    arr->hash_struct = stack_array_compute_hash_struct_(arr);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_push(StackArray *arr, stacksize_t id, Elem_t value)
+{
+    STACK_ARRAY_CHECK_STACK(arr, id)
+    if ( !stack_array_is_id_valid_(arr, id) ) return STACK_ERROR_BAD_ARG;
+
+    const int MEM_MULTIPLIER = 2;
+
+    StackArrayHeader *header = arr->headers + id;
+    if (header->size == header->capacity)
+    {
+        stacksize_t old_capacity = header->capacity;
+        if ( old_capacity == STACK_ARRAY_MAX_CAPACITY ) return STACK_ERROR_OVERFLOW;
+
+        stacksize_t new_capacity = MEM_MULTIPLIER * old_capacity;
+        if ( new_capacity < STACK_ARRAY_MIN_CAPACITY ) new_capacity = STACK_ARRAY_MIN_CAPACITY;
+        if ( new_capacity > STACK_ARRAY_MAX_CAPACITY ) new_capacity = STACK_ARRAY_MAX_CAPACITY;
+
+        stacksize_t offset = 0;
+        if ( (stacksize_t) header->offset + old_capacity == arr->used
+          && (stacksize_t) header->offset + new_capacity <= arr->capacity )
+        {
+            arr->used = (stacksize_t) header->offset + new_capacity;
+        }
+        else
+        {
+            StackErrorCode alloc_res = stack_array_alloc_(arr, new_capacity, &offset);
+            if ( alloc_res )
+            {
+                return alloc_res;
+            }
+
+            // alloc_ may have compacted the arena, so the old offset is read only now
+            if (header->size > 0) memcpy(arr->data + offset, arr->data + header->offset, header->size*sizeof(Elem_t));
+#ifdef STACK_USE_POISON
+            stack_array_fill_with_poison_(arr, header->offset, (stacksize_t) header->offset + old_capacity);
+#endif
+            stack_array_release_(arr, header->offset, old_capacity);
+            header->offset = (uint32_t) offset;
+        }
+        header->capacity = (uint32_t) new_capacity;
+    }
+
+    arr->data[header->offset + (header->size)++] = value;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stack_array_update_hash_stack_(arr, id);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_pop(StackArray *arr, stacksize_t id, Elem_t *ret_value)
+{
+    STACK_ARRAY_CHECK_STACK(arr, id)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if ( !stack_array_is_id_valid_(arr, id) ) return STACK_ERROR_BAD_ARG;
+
+    StackArrayHeader *header = arr->headers + id;
+    if (header->size == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        STACK_ARRAY_DUMP(arr, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    Elem_t *top = arr->data + header->offset + --(header->size);
+    *ret_value = *top;
+#ifdef STACK_USE_POISON
+    fill_elem_with_poison_(top);
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stack_array_update_hash_stack_(arr, id);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_view(StackArray *arr, stacksize_t id, const Elem_t **ret_data, stacksize_t *ret_size)
+{
+    STACK_ARRAY_CHECK_STACK(arr, id)
+    if ( !ret_data || !ret_size ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if ( !stack_array_is_id_valid_(arr, id) ) return STACK_ERROR_BAD_ARG;
+
+    *ret_data = arr->data + arr->headers[id].offset;
+    *ret_size = arr->headers[id].size;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode stack_array_compact(StackArray *arr, stacksize_t reserve)
+{
+    STACK_ARRAY_CHECK(arr)
+    if ( reserve < 0 ) return STACK_ERROR_BAD_ARG;
+
+    stacksize_t need = 0;
+    for (stacksize_t id = 0; id < arr->count; id++)
+    {
+        if (arr->headers[id].size != STACK_ARRAY_FREE_ID) need += arr->headers[id].size;
+    }
+
+    if ( need + reserve > (stacksize_t) UINT32_MAX ) return STACK_ERROR_OVERFLOW;
+
+    StackErrorCode move_res = stack_array_move_arena_(arr, need + reserve, 1, 1);
+
+#ifdef STACK_USE_PROTECTION_HASH
+    arr->hash_struct = stack_array_compute_hash_struct_(arr);
+#endif
+
+    return move_res;
+}
+
+size_t stack_array_memory(const StackArray *arr)
+{
+    assert(arr);
+
+    size_t memory = sizeof(*arr) + (size_t) arr->headers_capacity*sizeof(StackArrayHeader);
+    if (arr->data) memory += stack_data_block_size_( (size_t) arr->capacity*sizeof(Elem_t), sizeof(Elem_t) );
+
+    return memory;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+#ifdef STACK_USE_PROTECTION_HASH
+//! @brief Rehashes every stack and prints ids of the ones which don't match their headers.
+inline void stack_array_dump_damaged_stacks_(StackArray *arr)
+{
+    if ( stack_array_verify_struct_(arr) & (STACK_VERIFY_DATA_PNT_WRONG | STACK_VERIFY_SIZE_INVALID) )
+    {
+        fprintf(stderr, "	Sizes are broken, damaged stacks can't be found.\n");
+        return;
+    }
+
+    fprintf(stderr, "	Damaged stacks:");
+    stacksize_t damaged = 0;
+    for (stacksize_t id = 0; id < arr->count; id++)
+    {
+        if ( arr->headers[id].hash == stack_array_compute_hash_stack_(arr, id) ) continue;
+
+        if (damaged < STACK_ARRAY_DUMP_MAX_STACKS) fprintf(stderr, " " STACKSIZE_T_SPECF, id);
+        damaged++;
+    }
+
+    if (damaged > STACK_ARRAY_DUMP_MAX_STACKS)
+    {
+        fprintf(stderr, " ... (" STACKSIZE_T_SPECF " in total)", damaged);
+    }
+    fprintf(stderr, (damaged) ? "\n" : " none, all stacks match their hashes.\n");
+    if ( arr->hash_headers != stack_array_sum_hashes_(arr) )
+    {
+        fprintf(stderr, "\thash_headers doesn't match the hashes in headers.\n");
+    }
+}
+#endif
+
+void stack_array_dump_(StackArray *arr, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!arr)
+    {
+        stack_dump_header_(stderr, "StackArray", arr, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "StackArray", arr, verify_res, arr->stack_name, arr->orig_file_name,
+                        arr->orig_line, arr->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", arr->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", arr->canary_right);
+#endif
+    fprintf(stderr, "\tused = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcapacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\tgarbage = <" STACKSIZE_T_SPECF ">\n"
+                    "\tcount = <" STACKSIZE_T_SPECF ">\n"
+                    "\theaders_capacity = <" STACKSIZE_T_SPECF ">\n"
+                    "\tlive = <" STACKSIZE_T_SPECF ">\n"
+                    "\tfree_head = <" STACKSIZE_T_SPECF ">\n"
+                    "\theaders[%p]\n"
+                    "\tdata[%p]\n", arr->used, arr->capacity, arr->garbage, arr->count, arr->headers_capacity,
+                                    arr->live, arr->free_head, (void *) arr->headers, (void *) arr->data);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n"
+                    "\thash_headers = <" STACKHASH_T_SPECF ">\n", arr->hash_struct, arr->hash_headers);
+#endif
+    if ( !(arr->headers) || arr->count <= 0 || arr->count > arr->headers_capacity )
+    {
+        fprintf(stderr, "No headers can be accessed.\n");
+        fprintf(stderr, "}\n");
+        return;
+    }
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stack_array_dump_damaged_stacks_(arr);
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    if (arr->data)
+    {
+        fprintf(stderr, "\tLeft data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) arr->p_data_canary_left,
+                                                                            *(arr->p_data_canary_left));
+    }
+#endif
+    stacksize_t last_id = (arr->count < STACK_ARRAY_DUMP_MAX_STACKS) ? arr->count : STACK_ARRAY_DUMP_MAX_STACKS;
+    for (stacksize_t id = 0; id < last_id; id++)
+    {
+        const StackArrayHeader *header = arr->headers + id;
+        if (header->size == STACK_ARRAY_FREE_ID)
+        {
+            fprintf(stderr, "\tstack " STACKSIZE_T_SPECF ": free\n", id);
+            continue;
+        }
+
+#ifdef STACK_USE_PROTECTION_HASH
+        fprintf(stderr, "\tstack " STACKSIZE_T_SPECF ": offset = <%u>, size = <%u>, capacity = <%u>, hash = <%u>\n",
+                        id, header->offset, header->size, header->capacity, header->hash);
+#else
+        fprintf(stderr, "\tstack " STACKSIZE_T_SPECF ": offset = <%u>, size = <%u>, capacity = <%u>\n",
+                        id, header->offset, header->size, header->capacity);
+#endif
+        if ( !arr->data || !stack_array_is_id_valid_(arr, id) ) continue;
+
+        stacksize_t size = header->size;
+        stacksize_t first = (size > 8) ? size - 8 : 0;
+        stacksize_t last = (size + 2 < (stacksize_t) header->capacity) ? size + 2 : header->capacity;
+        fprintf(stderr, "\t{\n");
+        stack_dump_elems_(stderr, arr->data + header->offset, size, header->capacity, first, last, 1);
+        fprintf(stderr, "\t}\n");
+    }
+    if (last_id < arr->count)
+    {
+        fprintf(stderr, "\t... " STACKSIZE_T_SPECF " more stacks skipped\n", arr->count - last_id);
+    }
+#ifdef STACK_USE_PROTECTION_CANARY
+    if (arr->data)
+    {
+        fprintf(stderr, "\tRight data canary[%p] = <" CANARY_T_SPECF ">\n", (void *) arr->p_data_canary_right,
+                                                                             *(arr->p_data_canary_right));
+    }
+#endif
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // STACK_ARRAY_H
@@ -0,0 +1,49 @@
+#ifndef STACK_DUMP_FORMAT_H
+#define STACK_DUMP_FORMAT_H
+
+#include <stdint.h>
+
+/*
+    Format of raw binary dumps written by stack_dump_raw() and read by tools/stack_dump_decode.
+    This header doesn't need Elem_t, so it can be included by tools on its own.
+
+    The file consists of StackRawDumpHeader followed by arrays_num*capacity elements of
+    elem_size bytes each: data[0..capacity) and, if arrays_num == 2, aggr[0..capacity).
+    Numbers are written in the byte order of the machine which made the dump; compare
+    endian_check with STACK_RAW_DUMP_ENDIAN_CHECK to be sure it is the same as yours.
+*/
+
+const char     STACK_RAW_DUMP_MAGIC[8]      = "STKDUMP";
+const uint32_t STACK_RAW_DUMP_VERSION       = 1;
+const uint32_t STACK_RAW_DUMP_ENDIAN_CHECK  = 0x01020304;
+
+//! @brief Mask of these values is written in StackRawDumpHeader::flags.
+enum StackRawDumpFlag
+{
+    STACK_RAW_DUMP_HAS_CANARY       = 1 << 0, //< canary_data_left and canary_data_right are valid.
+    STACK_RAW_DUMP_HAS_HASH         = 1 << 1, //< hash_data is valid.
+    STACK_RAW_DUMP_HAS_POISON       = 1 << 2, //< Empty elements are filled with poison_value bytes.
+    STACK_RAW_DUMP_HAS_AGGREGATE    = 1 << 3, //< Aggregates follow data, arrays_num == 2.
+};
+
+struct StackRawDumpHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t endian_check;
+    uint32_t elem_size;
+    uint32_t arrays_num;
+    uint32_t flags;
+    int32_t  verify_res;
+    int64_t  size;
+    int64_t  capacity;
+    uint64_t hash_data;
+    uint64_t canary_data_left;
+    uint64_t canary_data_right;
+    uint8_t  poison_value;
+    uint8_t  reserved[7];
+};
+
+static_assert(sizeof(StackRawDumpHeader) == 80, "StackRawDumpHeader must have no padding");
+
+#endif // STACK_DUMP_FORMAT_H
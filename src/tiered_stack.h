@@ -0,0 +1,777 @@
+#ifndef TIERED_STACK_H
+#define TIERED_STACK_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "stack.h"
+
+/*
+    Stack which keeps only about hot_elems top elements in memory and spills the cold bottom
+    to a temporary file by blocks of TIERED_STACK_BLOCK_ELEMS elements. Linux only, link with
+    -pthread.
+
+    Spilling is write-behind: push hands the bottom block to a background thread and goes on.
+    When pops bring the number of elements in memory down to hot_elems / 2, the next block is
+    read back ahead of time by the same thread, so pop waits only if the disk is slower than
+    the pops (such pops are counted in stalls). Jobs are done in order, so a block is never
+    read before it is written.
+
+    With STACK_USE_PROTECTION_HASH every spilled block is hashed by stack_compute_hash() when
+    written and rehashed when read back; if the hashes differ, verification reports
+    STACK_VERIFY_DATA_HASH_INVALID. Blocks in memory are not hashed, only the struct is.
+
+    USAGE:
+    TieredStack stk = {};
+    tiered_stack_ctor(&stk, 1 << 20, NULL);     // ~1M hot elements, spill file in /tmp
+    tiered_stack_push(&stk, value);
+    tiered_stack_pop(&stk, &value);
+*/
+
+#ifndef TIERED_STACK_BLOCK_ELEMS
+//! @brief Number of elements spilled or read back at once.
+#define TIERED_STACK_BLOCK_ELEMS 4096
+#endif
+
+//! @brief Maximum number of spill jobs not yet done; push waits if the disk is that far behind.
+const long TIERED_STACK_MAX_JOBS = 64;
+
+const char TIERED_STACK_DEFAULT_SPILL_DIR[] = "/tmp";
+
+enum TieredStackJobType
+{
+    TIERED_STACK_JOB_WRITE  = 0, //< Write block to the spill file and free its buffer.
+    TIERED_STACK_JOB_READ   = 1, //< Read block from the spill file to a new buffer.
+};
+
+//! @brief Spill job, done by the background thread.
+struct TieredStackJob_
+{
+    TieredStackJobType type;
+    stacksize_t block;
+    Elem_t *buf;
+    int is_failed;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t hash;
+#endif
+};
+
+//! @brief State shared with the background thread. It is allocated separately, so that
+//! the thread doesn't touch TieredStack and doesn't break its hash.
+struct TieredStackIO_
+{
+    pthread_mutex_t lock;
+    pthread_cond_t job_added;
+    pthread_cond_t job_done;
+    pthread_t thread;
+
+    int fd;
+    int is_stopped;
+    long jobs_added;
+    long jobs_done;     //< Пишется только фоновым потоком, читается атомарно.
+
+    TieredStackJob_ jobs[TIERED_STACK_MAX_JOBS];
+};
+
+struct TieredStack
+{
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_left = 0;
+#endif
+
+    Elem_t **blocks = NULL;             //< Указатели на блоки в памяти, NULL для выгруженных.
+    stacksize_t blocks_capacity = -1;
+    stacksize_t size = -1;
+    stacksize_t spilled_blocks = -1;    //< Блоки [0, spilled_blocks) лежат в файле или пишутся в него.
+    stacksize_t hot_elems = -1;
+    Elem_t *spare_block = NULL;         //< Освободившийся блок, чтобы не звать malloc() на границе блоков.
+
+    TieredStackIO_ *io = NULL;
+    long jobs_reaped = -1;
+    long prefetch_job = -1;             //< Номер задания чтения блока spilled_blocks - 1 или -1.
+    Elem_t *prefetched = NULL;          //< Прочитанный заранее блок, ещё не возвращённый в blocks.
+    stacksize_t stalls = -1;            //< Сколько раз pop() ждал чтения с диска.
+    int is_io_failed = 0;
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t *spill_hashes = NULL;
+    stacksize_t damaged_block = -1;
+    stackhash_t hash_struct = HASH_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_DO_DUMP
+    const char *stack_name = NULL;
+    const char *orig_file_name = NULL;
+    int orig_line = -1;
+    const char *orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    canary_t canary_right = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------------------------------
+
+//! @brief Checks tiered stack's condition.
+//! @param [in] stk Stack to check.
+//! @return Mask composed from StackVerifyResFlag enum values, equaling 0 if the stack is fine.
+static int tiered_stack_verify(TieredStack *stk);
+
+//! @brief Tiered stack constructor. ONLY FOR INTERNAL USE! USE MACRO tiered_stack_ctor()!
+//! @details Creates the spill file (it is deleted at once and vanishes when closed) and starts the background thread.
+//! @param [in] stk Pointer to stack to construct.
+//! @param [in] hot_elems Number of top elements kept in memory, at least 2 blocks are kept anyway.
+//! @param [in] spill_dir Directory for the spill file, TIERED_STACK_DEFAULT_SPILL_DIR if NULL.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if the spill file can't be created.
+StackErrorCode tiered_stack_ctor_( TieredStack *stk, stacksize_t hot_elems, const char *spill_dir
+#ifdef STACK_DO_DUMP
+                                   ,
+                                   const char *stack_name,
+                                   const char *orig_file_name,
+                                   const int orig_line,
+                                   const char *orig_func_name
+#endif
+                                 );
+
+//! @brief Tiered stack deconstructor. Waits for the background thread and closes the spill file.
+//! @param [in] stk Pointer to stack to deconstruct.
+//! @return StackErrorCode enum value.
+static StackErrorCode tiered_stack_dtor(TieredStack *stk);
+
+//! @brief Pushes element to the stack, spilling the bottom block if there are too many elements in memory.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] value Value to push.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if spilling or reading a block back has failed.
+//! The value is pushed even if reading back has failed just now.
+static StackErrorCode tiered_stack_push(TieredStack *stk, Elem_t value);
+
+//! @brief Pops element from the stack, reading blocks back ahead of time.
+//! @param [in] stk Pointer to the stack.
+//! @param [in] ret_value Pointer to put popped value to.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if reading or writing the spill file has failed.
+static StackErrorCode tiered_stack_pop(TieredStack *stk, Elem_t *ret_value);
+
+#ifndef STACK_DO_DUMP
+
+#define TIERED_STACK_DUMP(stk, verify_res) (void(0))
+
+#else  //STACK_DO_DUMP is turned on
+
+#define TIERED_STACK_DUMP(stk, verify_res) tiered_stack_dump_( (stk), verify_res, __FILE__, __LINE__, __func__)
+
+static void tiered_stack_dump_(TieredStack *stk, int verify_res, const char *file, int line, const char *func);
+
+#endif //STACK_DO_DUMP
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+//----------------------------------TIERED_STACK.CPP------------------------------------
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#define TIERED_STACK_CHECK(stk)    {                \
+    int verify_res = tiered_stack_verify(stk);      \
+    if ( verify_res != 0 ) {                        \
+        TIERED_STACK_DUMP(stk, verify_res);         \
+        return STACK_ERROR_VERIFY;                  \
+    }                                               \
+}
+
+const size_t TIERED_STACK_BLOCK_BYTES = TIERED_STACK_BLOCK_ELEMS*sizeof(Elem_t);
+
+#ifdef STACK_USE_PROTECTION_HASH
+inline stackhash_t tiered_stack_compute_hash_struct_(TieredStack *stk)
+{
+    assert(stk);
+
+    stackhash_t curr_hash = stk->hash_struct;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+    stackhash_t actual_hash = stack_compute_hash( (char *) stk, sizeof(*stk) );
+    stk->hash_struct = curr_hash;
+
+    return actual_hash;
+}
+#endif
+
+int tiered_stack_verify(TieredStack *stk)
+{
+    if ( !stk ) return STACK_VERIFY_NULL_PNT;
+
+    int error = 0;
+
+    if ( !(stk->io) || ( !(stk->blocks) && stk->blocks_capacity != 0 ) )
+    error |= STACK_VERIFY_DATA_PNT_WRONG;
+
+    if ( stk->size < 0 || stk->spilled_blocks < 0 || stk->spilled_blocks * TIERED_STACK_BLOCK_ELEMS > stk->size
+      || stk->size > stk->blocks_capacity * TIERED_STACK_BLOCK_ELEMS )
+    error |= STACK_VERIFY_SIZE_INVALID;
+
+    if ( stk->blocks_capacity < 0 || stk->hot_elems < 2*TIERED_STACK_BLOCK_ELEMS )
+    error |= STACK_VERIFY_CAPACITY_INVALID;
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    if ( stk->canary_left != CANARY_LEFT_DEFAULT_VALUE
+      || stk->canary_right != CANARY_RIGHT_DEFAULT_VALUE )
+    error |= STACK_VERIFY_CANARY_STRCUT_DMG;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if ( stk->hash_struct != tiered_stack_compute_hash_struct_(stk) )
+    error |= STACK_VERIFY_STRUCT_HASH_INVALID;
+
+    if ( stk->damaged_block >= 0 )
+    error |= STACK_VERIFY_DATA_HASH_INVALID;
+#endif
+
+    return error;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+//! @brief Calls pwrite() or pread() until all the bytes are done.
+//! @return 0 on success, -1 on failure.
+inline int tiered_stack_do_io_(int fd, TieredStackJobType type, char *buf, size_t bytes, off_t offset)
+{
+    while (bytes > 0)
+    {
+        ssize_t done = (type == TIERED_STACK_JOB_WRITE) ? pwrite(fd, buf, bytes, offset)
+                                                        : pread(fd, buf, bytes, offset);
+        if (done <= 0) return -1;
+
+        buf += done;
+        bytes -= (size_t) done;
+        offset += done;
+    }
+
+    return 0;
+}
+
+//! @brief Background thread: does jobs in order, hashing blocks out of the main thread.
+inline void *tiered_stack_io_thread_(void *io_pnt)
+{
+    TieredStackIO_ *io = (TieredStackIO_ *) io_pnt;
+
+    long next = 0;
+    while (1)
+    {
+        pthread_mutex_lock(&io->lock);
+        while (next == io->jobs_added && !io->is_stopped)
+        {
+            pthread_cond_wait(&io->job_added, &io->lock);
+        }
+        if (next == io->jobs_added)
+        {
+            pthread_mutex_unlock(&io->lock);
+            break;
+        }
+        TieredStackJob_ *job = &io->jobs[next % TIERED_STACK_MAX_JOBS];
+        pthread_mutex_unlock(&io->lock);
+
+        off_t offset = (off_t) job->block * (off_t) TIERED_STACK_BLOCK_BYTES;
+#ifdef STACK_USE_PROTECTION_HASH
+        if (job->type == TIERED_STACK_JOB_WRITE)
+        {
+            job->hash = stack_compute_hash( (char *) job->buf, (unsigned int) TIERED_STACK_BLOCK_BYTES );
+        }
+#endif
+        job->is_failed = tiered_stack_do_io_(io->fd, job->type, (char *) job->buf, TIERED_STACK_BLOCK_BYTES, offset);
+#ifdef STACK_USE_PROTECTION_HASH
+        if (job->type == TIERED_STACK_JOB_READ && !job->is_failed)
+        {
+            job->hash = stack_compute_hash( (char *) job->buf, (unsigned int) TIERED_STACK_BLOCK_BYTES );
+        }
+#endif
+
+        next++;
+        pthread_mutex_lock(&io->lock);
+        __atomic_store_n(&io->jobs_done, next, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&io->job_done);
+        pthread_mutex_unlock(&io->lock);
+    }
+
+    return NULL;
+}
+
+//! @brief Takes results of the done jobs in order: frees written blocks and blocks which failed
+//! to be read, keeps the prefetched one.
+inline void tiered_stack_reap_jobs_(TieredStack *stk)
+{
+    assert(stk);
+
+    long jobs_done = __atomic_load_n(&stk->io->jobs_done, __ATOMIC_ACQUIRE);
+    while (stk->jobs_reaped < jobs_done)
+    {
+        TieredStackJob_ *job = &stk->io->jobs[stk->jobs_reaped % TIERED_STACK_MAX_JOBS];
+
+        if (job->is_failed)
+        {
+            stk->is_io_failed = 1;
+        }
+
+        if (job->type == TIERED_STACK_JOB_WRITE)
+        {
+#ifdef STACK_USE_PROTECTION_HASH
+            stk->spill_hashes[job->block] = job->hash;
+#endif
+            free(job->buf);
+        }
+        else
+        {
+#ifdef STACK_USE_PROTECTION_HASH
+            if ( !job->is_failed && job->hash != stk->spill_hashes[job->block] )
+            {
+                stk->damaged_block = job->block;
+            }
+#endif
+            if (job->is_failed) free(job->buf);
+            else                stk->prefetched = job->buf;
+        }
+        job->buf = NULL;
+
+        stk->jobs_reaped++;
+    }
+}
+
+//! @brief Waits until the background thread finishes job number job_num.
+inline void tiered_stack_wait_job_(TieredStack *stk, long job_num)
+{
+    assert(stk);
+
+    pthread_mutex_lock(&stk->io->lock);
+    while (stk->io->jobs_done <= job_num)
+    {
+        pthread_cond_wait(&stk->io->job_done, &stk->io->lock);
+    }
+    pthread_mutex_unlock(&stk->io->lock);
+
+    tiered_stack_reap_jobs_(stk);
+}
+
+//! @brief Queues a job, waiting for a free slot if the disk is TIERED_STACK_MAX_JOBS jobs behind.
+//! @return Number of the job.
+inline long tiered_stack_add_job_(TieredStack *stk, TieredStackJobType type, stacksize_t block, Elem_t *buf)
+{
+    assert(stk);
+
+    if (stk->io->jobs_added - stk->jobs_reaped >= TIERED_STACK_MAX_JOBS)
+    {
+        tiered_stack_wait_job_(stk, stk->jobs_reaped);
+    }
+
+    pthread_mutex_lock(&stk->io->lock);
+    long job_num = stk->io->jobs_added;
+    TieredStackJob_ *job = &stk->io->jobs[job_num % TIERED_STACK_MAX_JOBS];
+    job->type = type;
+    job->block = block;
+    job->buf = buf;
+    job->is_failed = 0;
+    stk->io->jobs_added++;
+    pthread_cond_signal(&stk->io->job_added);
+    pthread_mutex_unlock(&stk->io->lock);
+
+    return job_num;
+}
+
+//! @brief Puts the prefetched block back to memory, if it has been read. If wait is non-zero, waits for it.
+//! @return StackErrorCode enum value, STACK_ERROR_IO if the block couldn't be read.
+inline StackErrorCode tiered_stack_take_prefetched_(TieredStack *stk, int wait)
+{
+    assert(stk);
+
+    if (stk->prefetch_job < 0) return STACK_ERROR_NO_ERROR;
+
+    if (wait && stk->jobs_reaped <= stk->prefetch_job)
+    {
+        tiered_stack_wait_job_(stk, stk->prefetch_job);
+    }
+    if (stk->jobs_reaped <= stk->prefetch_job) return STACK_ERROR_NO_ERROR;
+
+    stk->prefetch_job = -1;
+    if (!stk->prefetched) return STACK_ERROR_IO;
+
+    stk->spilled_blocks--;
+    stk->blocks[stk->spilled_blocks] = stk->prefetched;
+    stk->prefetched = NULL;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//! @brief Grows the arrays indexed by block number so that block fits.
+inline StackErrorCode tiered_stack_fit_block_(TieredStack *stk, stacksize_t block)
+{
+    assert(stk);
+
+    const int MEM_MULTIPLIER = 2;
+
+    if (block < stk->blocks_capacity) return STACK_ERROR_NO_ERROR;
+
+    stacksize_t new_capacity = (stk->blocks_capacity == 0) ? MEM_MULTIPLIER : MEM_MULTIPLIER*stk->blocks_capacity;
+
+    Elem_t **new_blocks = (Elem_t **) realloc(stk->blocks, (size_t) new_capacity*sizeof(Elem_t *));
+    if (!new_blocks) return STACK_ERROR_MEM_BAD_REALLOC;
+    stk->blocks = new_blocks;
+    memset(stk->blocks + stk->blocks_capacity, 0, (size_t) (new_capacity - stk->blocks_capacity)*sizeof(Elem_t *));
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stackhash_t *new_hashes = (stackhash_t *) realloc(stk->spill_hashes, (size_t) new_capacity*sizeof(stackhash_t));
+    if (!new_hashes) return STACK_ERROR_MEM_BAD_REALLOC;
+    stk->spill_hashes = new_hashes;
+#endif
+
+    stk->blocks_capacity = new_capacity;
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//---------------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+#define tiered_stack_ctor(stk, hot_elems, spill_dir) tiered_stack_ctor_(stk, hot_elems, spill_dir, #stk, __FILE__, __LINE__, __func__)
+#else
+#define tiered_stack_ctor(stk, hot_elems, spill_dir) tiered_stack_ctor_(stk, hot_elems, spill_dir)
+#endif
+
+StackErrorCode tiered_stack_ctor_( TieredStack *stk, stacksize_t hot_elems, const char *spill_dir
+#ifdef STACK_DO_DUMP
+                                   ,
+                                   const char *stack_name,
+                                   const char *orig_file_name,
+                                   const int orig_line,
+                                   const char *orig_func_name
+#endif
+                                 )
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    tiered_stack_dtor(stk);
+
+    char spill_path[256] = "";
+    snprintf(spill_path, sizeof(spill_path), "%s/stack_spill_XXXXXX", (spill_dir) ? spill_dir : TIERED_STACK_DEFAULT_SPILL_DIR);
+    int fd = mkstemp(spill_path);
+    if (fd < 0) return STACK_ERROR_IO;
+    unlink(spill_path);
+
+    TieredStackIO_ *io = (TieredStackIO_ *) calloc(1, sizeof(TieredStackIO_));
+    if (!io)
+    {
+        close(fd);
+        return STACK_ERROR_MEM_BAD_REALLOC;
+    }
+    io->fd = fd;
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->job_added, NULL);
+    pthread_cond_init(&io->job_done, NULL);
+    if ( pthread_create(&io->thread, NULL, tiered_stack_io_thread_, io) != 0 )
+    {
+        close(fd);
+        free(io);
+        return STACK_ERROR_IO;
+    }
+
+    stk->io = io;
+    stk->blocks = NULL;
+    stk->blocks_capacity = 0;
+    stk->size = 0;
+    stk->spilled_blocks = 0;
+    stk->hot_elems = (hot_elems > 2*TIERED_STACK_BLOCK_ELEMS) ? hot_elems : 2*TIERED_STACK_BLOCK_ELEMS;
+    stk->spare_block = NULL;
+    stk->jobs_reaped = 0;
+    stk->prefetch_job = -1;
+    stk->prefetched = NULL;
+    stk->stalls = 0;
+    stk->is_io_failed = 0;
+#ifdef STACK_DO_DUMP
+    stk->stack_name = stack_name;
+    stk->orig_file_name = orig_file_name;
+    stk->orig_line = orig_line;
+    stk->orig_func_name = orig_func_name;
+#endif
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = CANARY_LEFT_DEFAULT_VALUE;
+    stk->canary_right = CANARY_RIGHT_DEFAULT_VALUE;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->spill_hashes = NULL;
+    stk->damaged_block = -1;
+    stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode tiered_stack_dtor(TieredStack *stk)
+{
+    if (!stk) return STACK_ERROR_NULL_STK_PNT_PASSED;
+
+    if (stk->io)
+    {
+        pthread_mutex_lock(&stk->io->lock);
+        stk->io->is_stopped = 1;
+        pthread_cond_signal(&stk->io->job_added);
+        pthread_mutex_unlock(&stk->io->lock);
+        pthread_join(stk->io->thread, NULL);
+
+        tiered_stack_reap_jobs_(stk);
+
+        close(stk->io->fd);
+        pthread_mutex_destroy(&stk->io->lock);
+        pthread_cond_destroy(&stk->io->job_added);
+        pthread_cond_destroy(&stk->io->job_done);
+        free(stk->io);
+    }
+    stk->io = NULL;
+
+    for (stacksize_t block = 0; block < stk->blocks_capacity; block++)
+    {
+        if (stk->blocks[block]) free(stk->blocks[block]);
+    }
+    if (stk->blocks) free(stk->blocks);
+    if (stk->spare_block) free(stk->spare_block);
+    if (stk->prefetched) free(stk->prefetched);
+
+    stk->blocks = NULL;
+    stk->blocks_capacity = -1;
+    stk->size = -1;
+    stk->spilled_blocks = -1;
+    stk->hot_elems = -1;
+    stk->spare_block = NULL;
+    stk->jobs_reaped = -1;
+    stk->prefetch_job = -1;
+    stk->prefetched = NULL;
+    stk->stalls = -1;
+    stk->is_io_failed = 0;
+
+#ifdef STACK_DO_DUMP
+    stk->stack_name = NULL;
+    stk->orig_file_name = NULL;
+    stk->orig_line = -1;
+    stk->orig_func_name = NULL;
+#endif
+
+#ifdef STACK_USE_PROTECTION_CANARY
+    stk->canary_left = 0;
+    stk->canary_right = 0;
+#endif
+
+#ifdef STACK_USE_PROTECTION_HASH
+    if (stk->spill_hashes) free(stk->spill_hashes);
+    stk->spill_hashes = NULL;
+    stk->damaged_block = -1;
+    stk->hash_struct = HASH_DEFAULT_VALUE;
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode tiered_stack_push(TieredStack *stk, Elem_t value)
+{
+    TIERED_STACK_CHECK(stk)
+    if (stk->is_io_failed) return STACK_ERROR_IO;
+
+    tiered_stack_reap_jobs_(stk);
+
+    stacksize_t block = stk->size / TIERED_STACK_BLOCK_ELEMS;
+    stacksize_t ind = stk->size % TIERED_STACK_BLOCK_ELEMS;
+    if (ind == 0)
+    {
+        StackErrorCode fit_res = tiered_stack_fit_block_(stk, block);
+        if ( fit_res )
+        {
+#ifdef STACK_USE_PROTECTION_HASH
+            stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+            return fit_res;
+        }
+
+        Elem_t *new_block = (stk->spare_block) ? stk->spare_block : (Elem_t *) malloc(TIERED_STACK_BLOCK_BYTES);
+        if (!new_block)
+        {
+#ifdef STACK_USE_PROTECTION_HASH
+            stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+            return STACK_ERROR_MEM_BAD_REALLOC;
+        }
+        stk->spare_block = NULL;
+#ifdef STACK_USE_POISON
+        memset(new_block, POISON_VALUE, TIERED_STACK_BLOCK_BYTES);
+#endif
+        stk->blocks[block] = new_block;
+    }
+
+    stk->blocks[block][ind] = value;
+    stk->size++;
+
+    if (stk->size - stk->spilled_blocks * TIERED_STACK_BLOCK_ELEMS > stk->hot_elems + TIERED_STACK_BLOCK_ELEMS)
+    {
+        // block being read back is the one right below the bottom, take it before spilling above it
+        StackErrorCode take_res = tiered_stack_take_prefetched_(stk, 1);
+        if ( take_res )
+        {
+#ifdef STACK_USE_PROTECTION_HASH
+            stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+            return take_res;
+        }
+
+        tiered_stack_add_job_(stk, TIERED_STACK_JOB_WRITE, stk->spilled_blocks, stk->blocks[stk->spilled_blocks]);
+        stk->blocks[stk->spilled_blocks] = NULL;
+        stk->spilled_blocks++;
+    }
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+StackErrorCode tiered_stack_pop(TieredStack *stk, Elem_t *ret_value)
+{
+    TIERED_STACK_CHECK(stk)
+    if ( !ret_value ) return STACK_ERROR_NULL_RET_VALUE_PNT;
+    if (stk->is_io_failed) return STACK_ERROR_IO;
+
+    if (stk->size == 0)
+    {
+#ifdef STACK_DUMP_ON_INVALID_POP
+        TIERED_STACK_DUMP(stk, 0);
+#endif
+        return STACK_ERROR_NOTHING_TO_POP;
+    }
+
+    tiered_stack_reap_jobs_(stk);
+
+    if (stk->size == stk->spilled_blocks * TIERED_STACK_BLOCK_ELEMS)
+    {
+        if (stk->prefetch_job < 0)
+        {
+            Elem_t *buf = (Elem_t *) malloc(TIERED_STACK_BLOCK_BYTES);
+            if (!buf)
+            {
+#ifdef STACK_USE_PROTECTION_HASH
+                stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+                return STACK_ERROR_MEM_BAD_REALLOC;
+            }
+            stk->prefetch_job = tiered_stack_add_job_(stk, TIERED_STACK_JOB_READ, stk->spilled_blocks - 1, buf);
+        }
+        if (stk->jobs_reaped <= stk->prefetch_job) stk->stalls++;
+        StackErrorCode take_res = tiered_stack_take_prefetched_(stk, 1);
+
+#ifdef STACK_USE_PROTECTION_HASH
+        stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+        if ( take_res )
+        {
+            return take_res;
+        }
+        TIERED_STACK_CHECK(stk)
+        if (stk->is_io_failed) return STACK_ERROR_IO;
+    }
+    else
+    {
+        StackErrorCode take_res = tiered_stack_take_prefetched_(stk, 0);
+        if ( take_res )
+        {
+#ifdef STACK_USE_PROTECTION_HASH
+            stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+            return take_res;
+        }
+    }
+
+    stk->size--;
+    stacksize_t block = stk->size / TIERED_STACK_BLOCK_ELEMS;
+    stacksize_t ind = stk->size % TIERED_STACK_BLOCK_ELEMS;
+
+    *ret_value = stk->blocks[block][ind];
+#ifdef STACK_USE_POISON
+    fill_elem_with_poison_(stk->blocks[block] + ind);
+#endif
+
+    if (ind == 0)
+    {
+        if (stk->spare_block) free(stk->spare_block);
+        stk->spare_block = stk->blocks[block];
+        stk->blocks[block] = NULL;
+    }
+
+    if ( stk->spilled_blocks > 0 && stk->prefetch_job < 0
+      && stk->size - stk->spilled_blocks * TIERED_STACK_BLOCK_ELEMS <= stk->hot_elems / 2 )
+    {
+        // the element is already popped and prefetching is only a hint, so it is skipped without memory
+        Elem_t *buf = (Elem_t *) malloc(TIERED_STACK_BLOCK_BYTES);
+        if (buf) stk->prefetch_job = tiered_stack_add_job_(stk, TIERED_STACK_JOB_READ, stk->spilled_blocks - 1, buf);
+    }
+
+#ifdef STACK_USE_PROTECTION_HASH
+    stk->hash_struct = tiered_stack_compute_hash_struct_(stk);
+#endif
+
+    return STACK_ERROR_NO_ERROR;
+}
+
+//-------------------------------------------------------------------------------------------------------
+
+#ifdef STACK_DO_DUMP
+
+void tiered_stack_dump_(TieredStack *stk, int verify_res, const char *file, const int line, const char *func)
+{
+    if (!stk)
+    {
+        stack_dump_header_(stderr, "TieredStack", stk, verify_res, NULL, NULL, -1, NULL, file, line, func);
+        fprintf(stderr, "Stack pointer is NULL, no further information is accessible.\n");
+        return;
+    }
+
+    stack_dump_header_( stderr, "TieredStack", stk, verify_res, stk->stack_name, stk->orig_file_name,
+                        stk->orig_line, stk->orig_func_name, file, line, func );
+
+    fprintf(stderr, "{\n");
+#ifdef STACK_USE_PROTECTION_CANARY
+    fprintf(stderr, "\tleft_canary = <" CANARY_T_SPECF ">\n", stk->canary_left);
+    fprintf(stderr, "\tright_canary = <" CANARY_T_SPECF ">\n", stk->canary_right);
+#endif
+    fprintf(stderr, "\tsize = <" STACKSIZE_T_SPECF ">\n"
+                    "\thot_elems = <" STACKSIZE_T_SPECF ">\n"
+                    "\tspilled_blocks = <" STACKSIZE_T_SPECF "> of %d elements\n"
+                    "\tprefetch_job = <%ld>\n"
+                    "\tjobs_reaped = <%ld>\n"
+                    "\tstalls = <" STACKSIZE_T_SPECF ">\n"
+                    "\tis_io_failed = <%d>\n"
+                    "\tblocks[%p]\n",   stk->size, stk->hot_elems, stk->spilled_blocks, TIERED_STACK_BLOCK_ELEMS,
+                                        stk->prefetch_job, stk->jobs_reaped, stk->stalls, stk->is_io_failed,
+                                        (void *) stk->blocks);
+#ifdef STACK_USE_PROTECTION_HASH
+    fprintf(stderr, "\thash_struct = <" STACKHASH_T_SPECF ">\n", stk->hash_struct);
+    if (stk->damaged_block >= 0)
+    {
+        fprintf(stderr, "\tSpilled block " STACKSIZE_T_SPECF " (elements [" STACKSIZE_T_SPECF ".." STACKSIZE_T_SPECF
+                        ")) doesn't match its hash after reading back.\n", stk->damaged_block,
+                        stk->damaged_block * TIERED_STACK_BLOCK_ELEMS, (stk->damaged_block + 1) * TIERED_STACK_BLOCK_ELEMS);
+    }
+#endif
+
+    stacksize_t top_block = (stk->size > 0) ? (stk->size - 1) / TIERED_STACK_BLOCK_ELEMS : -1;
+    if ( stk->blocks && 0 <= top_block && top_block < stk->blocks_capacity && stk->blocks[top_block] )
+    {
+        fprintf(stderr, "\tTop block " STACKSIZE_T_SPECF "[%p]:\n\t{\n", top_block, (void *) stk->blocks[top_block]);
+        stacksize_t top_size = stk->size - top_block * TIERED_STACK_BLOCK_ELEMS;
+        stack_dump_elems_( stderr, stk->blocks[top_block], top_size, TIERED_STACK_BLOCK_ELEMS,
+                           (top_size > 8) ? top_size - 8 : 0, (top_size + 8 < TIERED_STACK_BLOCK_ELEMS) ? top_size + 8 : TIERED_STACK_BLOCK_ELEMS, 1 );
+        fprintf(stderr, "\t}\n");
+    }
+
+    fprintf(stderr, "}\n");
+
+#ifdef STACK_ABORT_ON_DUMP
+    abort();
+#endif
+}
+
+#endif // STACK_DO_DUMP
+
+#endif // TIERED_STACK_H
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stack_dump_format.h"
+
+/*
+    Decodes raw dumps written by stack_dump_raw(). Elements are printed as hex bytes, since
+    the tool doesn't know Elem_t; runs of identical elements are collapsed into two lines.
+
+    USAGE:
+    ./tools/stack_dump_decode.exe <dump file> [first [last]]
+*/
+
+const size_t DECODE_CHUNK_ELEMS = 1 << 16;
+
+static void print_header(const StackRawDumpHeader *header)
+{
+    printf( "Raw stack dump, version %u\n"
+            "elem_size = <%u>\n"
+            "arrays_num = <%u>\n"
+            "verify_res = <%d>\n"
+            "size = <%lld>\n"
+            "capacity = <%lld>\n",  header->version, header->elem_size, header->arrays_num,
+                                    header->verify_res, (long long) header->size,
+                                    (long long) header->capacity );
+
+    if (header->flags & STACK_RAW_DUMP_HAS_CANARY)
+    {
+        printf("Left data canary = <%llX>\n"
+               "Right data canary = <%llX>\n",  (unsigned long long) header->canary_data_left,
+                                                (unsigned long long) header->canary_data_right);
+    }
+    if (header->flags & STACK_RAW_DUMP_HAS_HASH)
+    {
+        printf("hash_data = <%llX>\n", (unsigned long long) header->hash_data);
+    }
+}
+
+static int is_poison(const StackRawDumpHeader *header, const unsigned char *elem)
+{
+    if ( !(header->flags & STACK_RAW_DUMP_HAS_POISON) ) return 0;
+
+    for (uint32_t byte = 0; byte < header->elem_size; byte++)
+    {
+        if (elem[byte] != header->poison_value) return 0;
+    }
+
+    return 1;
+}
+
+static void print_elem(const StackRawDumpHeader *header, const unsigned char *elem, long long ind)
+{
+    printf("\t[%lld] = <", ind);
+    for (uint32_t byte = 0; byte < header->elem_size; byte++)
+    {
+        printf("%02X", elem[byte]);
+    }
+    printf(">");
+
+    if ( is_poison(header, elem) ) printf(" (POISON)");
+    if (ind == header->size) printf(" <--");
+
+    printf("\n");
+}
+
+//! @brief Prints elements [first, last) of one array, reading it by chunks.
+//! @return 0 on success, -1 if the file ended too early.
+static int decode_array( FILE *file, const StackRawDumpHeader *header, long array_offset,
+                         long long first, long long last )
+{
+    size_t elem_size = header->elem_size;
+    if ( fseek(file, array_offset + (long) (first*(long long) elem_size), SEEK_SET) ) return -1;
+
+    unsigned char *chunk = (unsigned char *) calloc(DECODE_CHUNK_ELEMS + 1, elem_size);
+    if (!chunk) return -1;
+    unsigned char *prev = chunk + DECODE_CHUNK_ELEMS*elem_size;
+
+    if (first > 0) printf("\t... [0..%lld) skipped\n", first);
+
+    long long run_first = -1;
+    long long ind = first;
+    while (ind < last)
+    {
+        size_t to_read = (size_t) (last - ind);
+        if (to_read > DECODE_CHUNK_ELEMS) to_read = DECODE_CHUNK_ELEMS;
+        if ( fread(chunk, elem_size, to_read, file) != to_read )
+        {
+            free(chunk);
+            return -1;
+        }
+
+        for (size_t i = 0; i < to_read; i++, ind++)
+        {
+            const unsigned char *elem = chunk + i*elem_size;
+
+            // run is broken at size, so that the marked element is always printed
+            if ( run_first >= 0 && ind != header->size && memcmp(elem, prev, elem_size) == 0 ) continue;
+
+            if (run_first >= 0 && ind - run_first > 1)
+            {
+                printf("\t... %lld more identical elements [%lld..%lld)\n", ind - run_first - 1, run_first + 1, ind);
+            }
+
+            print_elem(header, elem, ind);
+            memcpy(prev, elem, elem_size);
+            run_first = ind;
+        }
+    }
+
+    if (run_first >= 0 && last - run_first > 1)
+    {
+        printf("\t... %lld more identical elements [%lld..%lld)\n", last - run_first - 1, run_first + 1, last);
+    }
+    if (last < header->capacity) printf("\t... [%lld..%lld) skipped\n", last, (long long) header->capacity);
+
+    free(chunk);
+    return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "Usage: %s <dump file> [first [last]]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Can't open file %s\n", argv[1]);
+        return 1;
+    }
+
+    StackRawDumpHeader header = {};
+    if ( fread(&header, sizeof(header), 1, file) != 1
+      || memcmp(header.magic, STACK_RAW_DUMP_MAGIC, sizeof(header.magic)) != 0 )
+    {
+        fprintf(stderr, "%s is not a raw stack dump\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    if (header.version != STACK_RAW_DUMP_VERSION || header.endian_check != STACK_RAW_DUMP_ENDIAN_CHECK)
+    {
+        fprintf(stderr, "Dump version %u or byte order is not supported\n", header.version);
+        fclose(file);
+        return 1;
+    }
+
+    static char out_buffer[1 << 16] = {};
+    setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+
+    print_header(&header);
+
+    long long first = (argc > 2) ? atoll(argv[2]) : 0;
+    long long last  = (argc > 3) ? atoll(argv[3]) : header.capacity;
+    if (first < 0) first = 0;
+    if (last > header.capacity) last = header.capacity;
+
+    const char *array_names[] = {"data", "aggr"};
+    for (uint32_t array = 0; array < header.arrays_num && array < 2; array++)
+    {
+        printf("%s:\n", array_names[array]);
+        long array_offset = (long) sizeof(header) + (long) (array*header.capacity*header.elem_size);
+        if ( decode_array(file, &header, array_offset, first, last) != 0 )
+        {
+            fflush(stdout);
+            fprintf(stderr, "Dump is truncated\n");
+            fclose(file);
+            return 1;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}